@@ -9,15 +9,12 @@
 #include <pcl/pcl_base.h>
 #include <pcl/visualization/cloud_viewer.h>
 #include <chrono>
+#include "frame_source.h"
 
 using namespace std;
 using namespace rs2;
 
-typedef pcl::PointXYZRGB 			pointType;
-typedef pcl::PointCloud<pointType> 	pointCloud;
-typedef pointCloud::Ptr 			pPointCloud;
-
-class ActD435
+class ActD435 : public FrameSource
 {
 public:
 	ActD435();
@@ -25,21 +22,11 @@ public:
 	ActD435& operator=(const ActD435&) = delete;
 	~ActD435();
 
-	void init(void);
-	pPointCloud update(void);
-
-private:
-	//-- For color-aligned point cloud
-	std::tuple<uint8_t, uint8_t, uint8_t> getColorTexture(rs2::video_frame texture, rs2::texture_coordinate Texture_XY);
-	pPointCloud pointsToPointCloud(const rs2::points& points, const rs2::video_frame& color);
-
-	//-- For point cloud without color
-	pPointCloud pointsToPointCloud(const rs2::points& points);
+	//-- An empty serial takes the first camera found
+	void init(const CaptureProfile& profile, const string& serial = "");
+	bool grab(DepthFrame& frame);
 
 private:
-	rs2::pointcloud  rs2Cloud;
-	rs2::points      rs2Points;
-
 	rs2::pipeline    pipe;
 	rs2::config      cfg;
 
@@ -47,8 +34,7 @@ private:
 	rs2::frameset    alignedFrameSet;
 
 	rs2::align       align;
-
-	pPointCloud		 cloudByRS2;
+	bool             alignToColor;
 
 	// pcl::visualization::CloudViewer viewer;
 };
@@ -0,0 +1,43 @@
+#include "camera_rig.h"
+#include <fstream>
+#include <sstream>
+
+#define DEG_TO_RAD (3.1415926 / 180.0)
+
+bool loadRig(const std::string& path, std::vector<RigEntry>& entries)
+{
+	std::ifstream file(path.c_str());
+	if (!file.is_open()) { return false; }
+
+	entries.clear();
+
+	std::string line;
+	while (std::getline(file, line))
+	{
+		//-- Blank lines and comments
+		size_t first = line.find_first_not_of(" \t\r");
+		if (first == std::string::npos || line[first] == '#') { continue; }
+
+		std::istringstream fields(line);
+		RigEntry entry;
+
+		if (!(fields >> entry.kind >> entry.target >> entry.x >> entry.y >> entry.z >> entry.roll >> entry.pitch >> entry.yaw)) { return false; }
+		if (entry.kind != "camera" && entry.kind != "sequence") { return false; }
+
+		entries.push_back(entry);
+	}
+
+	return !entries.empty();
+}
+
+Eigen::Matrix4f mountTransform(const RigEntry& entry)
+{
+	Eigen::Affine3f transform = Eigen::Affine3f::Identity();
+
+	transform.translate(Eigen::Vector3f(float(entry.x), float(entry.y), float(entry.z)));
+	transform.rotate(Eigen::AngleAxisf(float(entry.yaw * DEG_TO_RAD), Eigen::Vector3f::UnitY()));
+	transform.rotate(Eigen::AngleAxisf(float(entry.pitch * DEG_TO_RAD), Eigen::Vector3f::UnitX()));
+	transform.rotate(Eigen::AngleAxisf(float(entry.roll * DEG_TO_RAD), Eigen::Vector3f::UnitZ()));
+
+	return transform.matrix();
+}
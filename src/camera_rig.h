@@ -0,0 +1,44 @@
+#define _CRT_SECURE_NO_WARNINGS
+
+#ifndef CAMERA_RIG_H_
+#define CAMERA_RIG_H_
+
+#include <string>
+#include <vector>
+#include <Eigen/Dense>
+#include "frame_source.h"
+
+//-- One camera of the rig, extrinsics map its points into the frame of the first camera
+typedef struct
+{
+	FrameSource*    source;
+	Eigen::Matrix4f extrinsics;
+
+} CameraMount;
+
+typedef std::vector<CameraMount, Eigen::aligned_allocator<CameraMount> > CameraMounts;
+
+//-- Line of a rig file: "camera <serial> x y z roll pitch yaw" or "sequence <path> x y z roll pitch yaw"
+//-- Pose of the camera in the frame of the first one (x right, y down, z forward), meter and degree
+//-- The first line is the reference camera, give it a zero pose
+typedef struct
+{
+	std::string kind;
+	std::string target;
+
+	double x;
+	double y;
+	double z;
+
+	double roll;
+	double pitch;
+	double yaw;
+
+} RigEntry;
+
+bool loadRig(const std::string& path, std::vector<RigEntry>& entries);
+
+//-- Extrinsics of a rig entry, rotation applied as yaw * pitch * roll
+Eigen::Matrix4f mountTransform(const RigEntry& entry);
+
+#endif
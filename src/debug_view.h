@@ -0,0 +1,177 @@
+#define _CRT_SECURE_NO_WARNINGS
+
+#ifndef DEBUG_VIEW_H_
+#define DEBUG_VIEW_H_
+
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <stdint.h>
+#include <pcl/point_types.h>
+#include <pcl/point_cloud.h>
+#include <pcl/visualization/pcl_visualizer.h>
+#include "thread_profile.h"
+
+//-- Debug visualization policies of the locator
+
+//-- What an extracted point belongs to, the viewer picks the color
+enum DebugLabel
+{
+	DEBUG_LABEL_NONE = 0,
+	DEBUG_LABEL_FENSE,
+	DEBUG_LABEL_DUNE,
+	DEBUG_LABEL_CLUSTER,
+
+	DEBUG_LABEL_NUM
+};
+
+//-- Shows the vertical cloud with every extracted part colored
+//-- The locator thread only records one label per point, the viewer thread owns the window and builds the colored cloud
+template <typename PointT>
+class DebugView
+{
+public:
+	typedef pcl::PointCloud<PointT> Cloud;
+	typedef typename Cloud::Ptr     CloudPtr;
+
+	explicit DebugView(bool interactive) : quit(false), stopped(false), fresh(false)
+	{
+		//-- Offline runs go without viewer
+		if (!interactive) { return; }
+
+		viewerThread = std::thread(&DebugView::viewerLoop, this);
+	}
+
+	~DebugView()
+	{
+		quit = true;
+		if (viewerThread.joinable()) { viewerThread.join(); }
+	}
+
+	//-- Start the labels of a new cloud, the cloud is shared with the viewer and must not be modified afterwards
+	void reset(CloudPtr cloud)
+	{
+		frameCloud = cloud;
+		frameLabels.assign(cloud->points.size(), DEBUG_LABEL_NONE);
+	}
+
+	void paint(const std::vector<int>& indices, DebugLabel label)
+	{
+		for (size_t i = 0; i < indices.size(); i++)
+		{
+			frameLabels[indices[i]] = uint8_t(label);
+		}
+	}
+
+	//-- Hand the labeled cloud over, an undrawn previous frame is dropped
+	void update(void)
+	{
+		if (!viewerThread.joinable() || !frameCloud) { return; }
+
+		std::lock_guard<std::mutex> lock(frameMutex);
+		shownCloud = frameCloud;
+		shownLabels.swap(frameLabels);
+		fresh = true;
+	}
+
+	bool wasStopped(void) const { return stopped; }
+
+private:
+	void viewerLoop(void)
+	{
+		ThreadRoleScope role(THREAD_ROLE_BACKGROUND, "viewer");
+
+		//-- VTK wants the window used from the thread that created it
+		pcl::PointCloud<pcl::PointXYZRGB>::Ptr dstCloud(new pcl::PointCloud<pcl::PointXYZRGB>);
+		pcl::visualization::PCLVisualizer::Ptr viewer(new pcl::visualization::PCLVisualizer("Advanced Viewer"));
+		viewer->setBackgroundColor(0.259, 0.522, 0.957);
+		viewer->addPointCloud<pcl::PointXYZRGB>(dstCloud, "Destination Cloud");
+		viewer->addCoordinateSystem(0.2, "view point");
+		viewer->initCameraParameters();
+
+		CloudPtr cloud;
+		std::vector<uint8_t> labels;
+
+		while (!quit && !viewer->wasStopped())
+		{
+			viewer->spinOnce(10);
+
+			{
+				std::lock_guard<std::mutex> lock(frameMutex);
+				if (!fresh) { continue; }
+
+				cloud.swap(shownCloud);
+				labels.swap(shownLabels);
+				shownCloud.reset();
+				fresh = false;
+			}
+
+			colorize(*cloud, labels, *dstCloud);
+			viewer->updatePointCloud(dstCloud, "Destination Cloud");
+		}
+
+		stopped = true;
+	}
+
+	static void colorize(const Cloud& cloud, const std::vector<uint8_t>& labels, pcl::PointCloud<pcl::PointXYZRGB>& colored)
+	{
+		//-- Black for the rest, red fense, yellow dune, green cluster
+		static const uint8_t palette[DEBUG_LABEL_NUM][3] =
+		{
+			{ 0, 0, 0 },
+			{ 234, 67, 53 },
+			{ 251, 188, 5 },
+			{ 52, 168, 83 }
+		};
+
+		colored.points.resize(cloud.points.size());
+		colored.width = uint32_t(cloud.points.size());
+		colored.height = 1;
+
+		for (size_t i = 0; i < cloud.points.size(); i++)
+		{
+			pcl::PointXYZRGB& point = colored.points[i];
+			const uint8_t* color = palette[labels[i]];
+
+			point.x = cloud.points[i].x;
+			point.y = cloud.points[i].y;
+			point.z = cloud.points[i].z;
+			point.r = color[0];
+			point.g = color[1];
+			point.b = color[2];
+		}
+	}
+
+private:
+	std::thread           viewerThread;
+	std::atomic<bool>     quit;
+	std::atomic<bool>     stopped;
+
+	//-- Frame being labeled by the locator thread
+	CloudPtr              frameCloud;
+	std::vector<uint8_t>  frameLabels;
+
+	//-- Latest finished frame waiting for the viewer
+	std::mutex            frameMutex;
+	CloudPtr              shownCloud;
+	std::vector<uint8_t>  shownLabels;
+	bool                  fresh;
+};
+
+//-- Production policy, every call compiles to nothing
+template <typename PointT>
+class NoDebugView
+{
+public:
+	explicit NoDebugView(bool) {}
+
+	inline void reset(typename pcl::PointCloud<PointT>::Ptr) {}
+	inline void paint(const std::vector<int>&, DebugLabel) {}
+
+	inline void update(void) {}
+
+	inline bool wasStopped(void) const { return false; }
+};
+
+#endif
@@ -0,0 +1,270 @@
+#include "depth_sequence.h"
+#include "rvl_codec.h"
+
+//-- Fixed part of a depth frame record, followed by the depth payload
+typedef struct
+{
+	double   timestamp;
+	uint64_t number;
+
+	int32_t  width;
+	int32_t  height;
+	float    fx;
+	float    fy;
+	float    ppx;
+	float    ppy;
+	float    depthScale;
+
+	uint32_t codec;
+
+} DepthRecordHeader;
+
+//-- Version of the sequence file from its magic, 0 if it is none
+static int readSequenceVersion(std::ifstream& file)
+{
+	char magic[8];
+	if (!file.read(magic, 8)) { return 0; }
+
+	std::string version(magic, 8);
+	if (version == SEQUENCE_MAGIC) { return 2; }
+	if (version == SEQUENCE_MAGIC_V1) { return 1; }
+
+	return 0;
+}
+
+SequenceWriter::SequenceWriter() : codec(DEPTH_CODEC_RAW)
+{
+
+}
+
+SequenceWriter::~SequenceWriter()
+{
+	close();
+}
+
+bool SequenceWriter::open(const std::string& path)
+{
+	file.open(path.c_str(), std::ios::binary | std::ios::trunc);
+	if (!file.is_open()) { return false; }
+
+	file.write(SEQUENCE_MAGIC, 8);
+	return file.good();
+}
+
+void SequenceWriter::close(void)
+{
+	if (file.is_open()) { file.close(); }
+}
+
+void SequenceWriter::setCodec(uint32_t codec)
+{
+	this->codec = codec;
+}
+
+void SequenceWriter::write(const DepthFrame& frame)
+{
+	DepthRecordHeader header;
+	header.timestamp = frame.timestamp;
+	header.number = frame.number;
+	header.width = frame.intrinsics.width;
+	header.height = frame.intrinsics.height;
+	header.fx = frame.intrinsics.fx;
+	header.fy = frame.intrinsics.fy;
+	header.ppx = frame.intrinsics.ppx;
+	header.ppy = frame.intrinsics.ppy;
+	header.depthScale = frame.intrinsics.depthScale;
+	header.codec = codec;
+
+	const char* payload = reinterpret_cast<const char*>(frame.depth.data());
+	size_t payloadSize = frame.depth.size() * sizeof(uint16_t);
+
+	if (codec == DEPTH_CODEC_RVL)
+	{
+		rvlCompress(frame.depth.data(), frame.depth.size(), encoded);
+		payload = reinterpret_cast<const char*>(encoded.data());
+		payloadSize = encoded.size();
+	}
+
+	uint32_t type = RECORD_DEPTH_FRAME;
+	uint32_t size = uint32_t(sizeof(header) + payloadSize);
+
+	file.write(reinterpret_cast<const char*>(&type), sizeof(type));
+	file.write(reinterpret_cast<const char*>(&size), sizeof(size));
+	file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+	file.write(payload, payloadSize);
+}
+
+void SequenceWriter::write(const LocateRecord& record)
+{
+	uint32_t type = RECORD_LOCATE_RESULT;
+	uint32_t size = sizeof(record);
+
+	file.write(reinterpret_cast<const char*>(&type), sizeof(type));
+	file.write(reinterpret_cast<const char*>(&size), sizeof(size));
+	file.write(reinterpret_cast<const char*>(&record), sizeof(record));
+}
+
+void SequenceWriter::flush(void)
+{
+	file.flush();
+}
+
+PlaybackSource::PlaybackSource()
+{
+
+}
+
+PlaybackSource::~PlaybackSource()
+{
+
+}
+
+bool PlaybackSource::open(const std::string& path)
+{
+	file.open(path.c_str(), std::ios::binary);
+	if (!file.is_open()) { return false; }
+
+	//-- Depth frame records are the same in every version
+	return readSequenceVersion(file) > 0;
+}
+
+bool PlaybackSource::grab(DepthFrame& frame)
+{
+	uint32_t type = 0;
+	uint32_t size = 0;
+
+	while (file.read(reinterpret_cast<char*>(&type), sizeof(type)) &&
+		file.read(reinterpret_cast<char*>(&size), sizeof(size)))
+	{
+		if (type != RECORD_DEPTH_FRAME)
+		{
+			file.seekg(size, std::ios::cur);
+			continue;
+		}
+
+		//-- A record too short for its header is truncated or corrupt, nothing after it can be trusted
+		DepthRecordHeader header;
+		if (size < sizeof(header)) { return false; }
+		if (!file.read(reinterpret_cast<char*>(&header), sizeof(header))) { return false; }
+
+		frame.timestamp = header.timestamp;
+		frame.number = header.number;
+		frame.intrinsics.width = header.width;
+		frame.intrinsics.height = header.height;
+		frame.intrinsics.fx = header.fx;
+		frame.intrinsics.fy = header.fy;
+		frame.intrinsics.ppx = header.ppx;
+		frame.intrinsics.ppy = header.ppy;
+		frame.intrinsics.depthScale = header.depthScale;
+
+		frame.depth.resize(size_t(header.width) * header.height);
+
+		if (header.codec == DEPTH_CODEC_RVL)
+		{
+			encoded.resize(size - sizeof(header));
+			if (!file.read(reinterpret_cast<char*>(encoded.data()), encoded.size())) { return false; }
+			if (!rvlDecompress(encoded.data(), encoded.size(), frame.depth.data(), frame.depth.size())) { return false; }
+		}
+		else if (header.codec == DEPTH_CODEC_RAW)
+		{
+			file.read(reinterpret_cast<char*>(frame.depth.data()), frame.depth.size() * sizeof(uint16_t));
+		}
+		else
+		{
+			return false;
+		}
+
+		//-- A played back frame arrives when it is read
+		frame.arrival = hostClockMs();
+
+		return file.good();
+	}
+
+	return false;
+}
+
+ReplaySource::ReplaySource(const std::vector<DepthFrame>& frames) : frames(frames), next(0)
+{
+
+}
+
+bool ReplaySource::grab(DepthFrame& frame)
+{
+	if (next >= frames.size()) { return false; }
+
+	frame = frames[next++];
+	frame.arrival = hostClockMs();
+	return true;
+}
+
+RecordingSource::RecordingSource(FrameSource& source) : source(source)
+{
+
+}
+
+bool RecordingSource::open(const std::string& path)
+{
+	return writer.open(path);
+}
+
+bool RecordingSource::grab(DepthFrame& frame)
+{
+	if (!source.grab(frame)) { return false; }
+
+	writer.write(frame);
+	return true;
+}
+
+bool loadSequence(const std::string& path, std::vector<DepthFrame>& frames)
+{
+	PlaybackSource playback;
+	if (!playback.open(path)) { return false; }
+
+	DepthFrame frame;
+	while (playback.grab(frame))
+	{
+		frames.push_back(frame);
+	}
+
+	return true;
+}
+
+bool loadLocateRecords(const std::string& path, std::vector<LocateRecord>& records)
+{
+	std::ifstream file(path.c_str(), std::ios::binary);
+
+	int version = readSequenceVersion(file);
+	if (version == 0) { return false; }
+
+	uint32_t type = 0;
+	uint32_t size = 0;
+
+	while (file.read(reinterpret_cast<char*>(&type), sizeof(type)) &&
+		file.read(reinterpret_cast<char*>(&size), sizeof(size)))
+	{
+		//-- Version 1 records are a prefix of the current layout, the fields they lack stay 0
+		bool known = (version == 2) ? size == sizeof(LocateRecord) :
+			(size == LOCATE_RECORD_V1_SIZE || size == sizeof(LocateRecord));
+
+		if (type != RECORD_LOCATE_RESULT || !known)
+		{
+			file.seekg(size, std::ios::cur);
+			continue;
+		}
+
+		LocateRecord record = LocateRecord();
+		if (!file.read(reinterpret_cast<char*>(&record), size)) { break; }
+
+		//-- The padding of the old layout is not a count, and reused was uninitialized padding of version 1 writers
+		if (size == LOCATE_RECORD_V1_SIZE)
+		{
+			record.contextSwitches = 0;
+			record.migrations = 0;
+		}
+		if (version == 1) { record.reused = 0; }
+
+		records.push_back(record);
+	}
+
+	return true;
+}
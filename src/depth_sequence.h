@@ -0,0 +1,130 @@
+#define _CRT_SECURE_NO_WARNINGS
+
+#ifndef DEPTH_SEQUENCE_H_
+#define DEPTH_SEQUENCE_H_
+
+#include <fstream>
+#include <string>
+#include <vector>
+#include "frame_source.h"
+
+//-- File layout: 8 byte magic, then records of { uint32 type, uint32 size, payload[size] }
+//-- Readers skip record types they do not know, so new ones can be added freely
+//-- A new magic marks a changed layout of a known record, readers keep reading the older ones
+#define SEQUENCE_MAGIC             "FAJDSEQ2"
+#define SEQUENCE_MAGIC_V1          "FAJDSEQ1"   /* locate records without the thread counters or a valid reused flag */
+#define RECORD_DEPTH_FRAME         0x48545044   /* "DPTH" */
+#define RECORD_LOCATE_RESULT       0x544C5352   /* "RSLT" */
+
+#define DEPTH_CODEC_RAW            0
+#define DEPTH_CODEC_RVL            1            /* see rvl_codec.h */
+
+//-- Locate records of version 1 files end after the ROIs, padded to 8 bytes
+#define LOCATE_RECORD_V1_SIZE      128
+
+//-- Locator state after one frame, written by the flight recorder
+typedef struct
+{
+	double   timestamp;
+	uint64_t number;
+	uint32_t status;
+	uint32_t detected;
+
+	double   xDistance;
+	double   zDistance;
+	double   duneDistance;
+	double   fenseDistance;
+	double   angle;
+
+	double   latency;
+	int32_t  quality;
+
+	float    leftFenseROI[4];     /* xMin, xMax, zMin, zMax */
+	float    duneROI[4];
+	float    frontFenseROI[4];
+
+	uint32_t contextSwitches;     /* over the frame thread and the workers since the last record */
+	uint32_t migrations;
+
+	uint32_t reused;              /* the result of the last processed frame published again, see staticReuse */
+
+} LocateRecord;
+
+//-- Writes depth frames into a sequence file
+class SequenceWriter
+{
+public:
+	SequenceWriter();
+	SequenceWriter(const SequenceWriter&) = delete;
+	SequenceWriter& operator=(const SequenceWriter&) = delete;
+	~SequenceWriter();
+
+	bool open(const std::string& path);
+	void close(void);
+
+	//-- Codec of the depth frames written from now on, DEPTH_CODEC_RAW by default
+	void setCodec(uint32_t codec);
+
+	void write(const DepthFrame& frame);
+	void write(const LocateRecord& record);
+
+	void flush(void);
+
+private:
+	std::ofstream file;
+	uint32_t      codec;
+
+	std::vector<uint8_t> encoded;
+};
+
+//-- Streams depth frames of a sequence file from disk
+class PlaybackSource : public FrameSource
+{
+public:
+	PlaybackSource();
+	PlaybackSource(const PlaybackSource&) = delete;
+	PlaybackSource& operator=(const PlaybackSource&) = delete;
+	~PlaybackSource();
+
+	bool open(const std::string& path);
+	bool grab(DepthFrame& frame);
+
+private:
+	std::ifstream file;
+
+	std::vector<uint8_t> encoded;
+};
+
+//-- Replays frames already loaded into memory, for repeated runs over the same data
+class ReplaySource : public FrameSource
+{
+public:
+	ReplaySource(const std::vector<DepthFrame>& frames);
+
+	bool grab(DepthFrame& frame);
+
+private:
+	const std::vector<DepthFrame>& frames;
+	size_t next;
+};
+
+//-- Forwards frames of another source and writes each of them into a sequence file
+class RecordingSource : public FrameSource
+{
+public:
+	RecordingSource(FrameSource& source);
+
+	bool open(const std::string& path);
+	bool grab(DepthFrame& frame);
+
+private:
+	FrameSource&   source;
+	SequenceWriter writer;
+};
+
+bool loadSequence(const std::string& path, std::vector<DepthFrame>& frames);
+
+//-- Locator states saved along the frames of a flight recording
+bool loadLocateRecords(const std::string& path, std::vector<LocateRecord>& records);
+
+#endif
@@ -0,0 +1,327 @@
+#include "field_synth.h"
+#include <cmath>
+#include <limits>
+#include <random>
+
+#define DEG_TO_RAD (3.1415926 / 180.0)
+
+FieldLayout::FieldLayout() :
+leftFenseX(-0.25),
+fenseHeight(0.10),
+fenseThickness(0.05),
+hasDune(true),
+duneZ(2.5),
+duneXMin(-0.25),
+duneXMax(2.0),
+duneHeight(0.10),
+duneSlope(45.0),
+duneTopWidth(0.05),
+hasFrontFense(true),
+frontFenseZ(5.0),
+frontFenseXMin(-0.30),
+frontFenseXMax(3.0),
+hasGrassland(true),
+grasslandZMin(3.0),
+grasslandZMax(4.5),
+grassHeight(0.02),
+grassRoughness(0.01)
+{
+
+}
+
+DepthNoiseModel::DepthNoiseModel() :
+subpixel(0.08),
+baseline(0.050),
+holeRate(0.01),
+edgeJump(0.05),
+flyingPixelRate(0.5),
+occlusionShadow(true),
+minDepth(0.15),
+maxDepth(10.0),
+depthScale(0.001)
+{
+
+}
+
+bool d435Intrinsics(int width, int height, DepthIntrinsics& intrinsics)
+{
+	//-- Nominal focal lengths of the depth imagers, calibrated units differ by a few pixels
+	const struct { int width; int height; float focal; } modes[] =
+	{
+		{ 424,  240, 212.0f },
+		{ 640,  480, 383.0f },
+		{ 848,  480, 424.0f },
+		{ 1280, 720, 640.0f }
+	};
+
+	for (size_t i = 0; i < sizeof(modes) / sizeof(modes[0]); i++)
+	{
+		if (modes[i].width == width && modes[i].height == height)
+		{
+			intrinsics.width = width;
+			intrinsics.height = height;
+			intrinsics.fx = modes[i].focal;
+			intrinsics.fy = modes[i].focal;
+			intrinsics.ppx = (width - 1) * 0.5f;
+			intrinsics.ppy = (height - 1) * 0.5f;
+			intrinsics.depthScale = 0.001f;
+			return true;
+		}
+	}
+
+	return false;
+}
+
+FieldSynthesizer::FieldSynthesizer(const FieldLayout& layout, const DepthNoiseModel& noise, unsigned int seed) :
+layout(layout),
+noise(noise),
+seed(seed)
+{
+	//-- Ground
+	Solid ground;
+	ground.halfSpaces.push_back(Eigen::Vector4d(0.0, 1.0, 0.0, 0.0));
+	ground.rough = false;
+	solids.push_back(ground);
+
+	//-- Left fense along the whole field
+	addBox(Eigen::Vector3d(layout.leftFenseX - layout.fenseThickness, 0.0, -5.0),
+		Eigen::Vector3d(layout.leftFenseX, layout.fenseHeight, 20.0));
+
+	if (layout.hasDune) { addDune(); }
+
+	if (layout.hasFrontFense)
+	{
+		addBox(Eigen::Vector3d(layout.frontFenseXMin, 0.0, layout.frontFenseZ),
+			Eigen::Vector3d(layout.frontFenseXMax, layout.fenseHeight, layout.frontFenseZ + layout.fenseThickness));
+	}
+
+	if (layout.hasGrassland)
+	{
+		addBox(Eigen::Vector3d(layout.leftFenseX, 0.0, layout.grasslandZMin),
+			Eigen::Vector3d(layout.frontFenseXMax, layout.grassHeight, layout.grasslandZMax), true);
+	}
+}
+
+void FieldSynthesizer::addBox(Eigen::Vector3d minCorner, Eigen::Vector3d maxCorner, bool rough)
+{
+	Solid box;
+	box.rough = rough;
+
+	for (int axis = 0; axis < 3; axis++)
+	{
+		Eigen::Vector4d lower = Eigen::Vector4d::Zero();
+		Eigen::Vector4d upper = Eigen::Vector4d::Zero();
+
+		lower[axis] = -1.0;
+		lower[3] = -minCorner[axis];
+		upper[axis] = 1.0;
+		upper[3] = maxCorner[axis];
+
+		box.halfSpaces.push_back(lower);
+		box.halfSpaces.push_back(upper);
+	}
+
+	solids.push_back(box);
+}
+
+void FieldSynthesizer::addDune(void)
+{
+	//-- Trapezoid cross section in the y-z plane, extruded along x
+	double alpha = layout.duneSlope * DEG_TO_RAD;
+	double farFootZ = layout.duneZ + 2.0 * layout.duneHeight / tan(alpha) + layout.duneTopWidth;
+
+	Solid dune;
+	dune.rough = false;
+	dune.halfSpaces.push_back(Eigen::Vector4d(0.0, -1.0, 0.0, 0.0));
+	dune.halfSpaces.push_back(Eigen::Vector4d(0.0, 1.0, 0.0, layout.duneHeight));
+	dune.halfSpaces.push_back(Eigen::Vector4d(0.0, cos(alpha), -sin(alpha), -sin(alpha) * layout.duneZ));
+	dune.halfSpaces.push_back(Eigen::Vector4d(0.0, cos(alpha), sin(alpha), sin(alpha) * farFootZ));
+	dune.halfSpaces.push_back(Eigen::Vector4d(-1.0, 0.0, 0.0, -layout.duneXMin));
+	dune.halfSpaces.push_back(Eigen::Vector4d(1.0, 0.0, 0.0, layout.duneXMax));
+
+	solids.push_back(dune);
+}
+
+//-- Hash of a position on the field in [-1, 1], stands in for the grass texture
+static double fieldHash(double x, double z)
+{
+	double value = sin(x * 1271.1 + z * 3117.7) * 43758.5453;
+	return 2.0 * (value - floor(value)) - 1.0;
+}
+
+double FieldSynthesizer::castRay(const Eigen::Vector3d& origin, const Eigen::Vector3d& direction) const
+{
+	double nearest = std::numeric_limits<double>::infinity();
+
+	for (size_t s = 0; s < solids.size(); s++)
+	{
+		const Solid& solid = solids[s];
+
+		double tEnter = -std::numeric_limits<double>::infinity();
+		double tExit = std::numeric_limits<double>::infinity();
+		int enterPlane = -1;
+		bool missed = false;
+
+		for (size_t h = 0; h < solid.halfSpaces.size() && !missed; h++)
+		{
+			const Eigen::Vector4d& hs = solid.halfSpaces[h];
+			double denom = hs.head<3>().dot(direction);
+			double num = hs[3] - hs.head<3>().dot(origin);
+
+			if (std::abs(denom) < 1e-12)
+			{
+				missed = (num < 0.0);
+			}
+			else if (denom < 0.0)
+			{
+				if (num / denom > tEnter) { tEnter = num / denom; enterPlane = int(h); }
+			}
+			else
+			{
+				tExit = std::min(tExit, num / denom);
+			}
+		}
+
+		if (missed || tEnter <= 0.0 || tEnter > tExit) { continue; }
+
+		//-- Entering through the top face of a rough solid hits the grass
+		if (solid.rough && solid.halfSpaces[enterPlane][1] > 0.5 && direction[1] < -0.1)
+		{
+			Eigen::Vector3d hit = origin + tEnter * direction;
+			tEnter += layout.grassRoughness * fieldHash(hit[0], hit[2]) / -direction[1];
+		}
+
+		nearest = std::min(nearest, tEnter);
+	}
+
+	return nearest;
+}
+
+void FieldSynthesizer::render(const CameraPose& pose, const DepthIntrinsics& intrinsics,
+	unsigned long long number, DepthFrame& frame)
+{
+	//-- Camera axes are x right, y down, z forward
+	Eigen::Matrix3d rotation = (Eigen::AngleAxisd(pose.yaw * DEG_TO_RAD, Eigen::Vector3d::UnitY()) *
+		Eigen::AngleAxisd(pose.pitch * DEG_TO_RAD, Eigen::Vector3d::UnitX())).toRotationMatrix();
+	rotation.col(1) = -rotation.col(1);
+
+	Eigen::Vector3d origin(pose.x, pose.height, pose.z);
+
+	std::vector<float> depth(size_t(intrinsics.width) * intrinsics.height, 0.0f);
+
+	for (int v = 0; v < intrinsics.height; v++)
+	{
+		for (int u = 0; u < intrinsics.width; u++)
+		{
+			//-- Ray with unit z in camera coordinates, so the ray parameter is the depth
+			Eigen::Vector3d ray((u - intrinsics.ppx) / intrinsics.fx, (v - intrinsics.ppy) / intrinsics.fy, 1.0);
+			double t = castRay(origin, rotation * ray);
+
+			if (t < std::numeric_limits<double>::infinity()) { depth[size_t(v) * intrinsics.width + u] = float(t); }
+		}
+	}
+
+	applyNoise(intrinsics, number, depth);
+
+	frame.timestamp = 0.0;
+	frame.arrival = 0.0;
+	frame.number = number;
+	frame.intrinsics = intrinsics;
+	frame.intrinsics.depthScale = float(noise.depthScale);
+	frame.depth.resize(depth.size());
+
+	for (size_t i = 0; i < depth.size(); i++)
+	{
+		double units = depth[i] / noise.depthScale + 0.5;
+		frame.depth[i] = uint16_t(std::min(units, 65535.0));
+	}
+}
+
+void FieldSynthesizer::applyNoise(const DepthIntrinsics& intrinsics, unsigned long long number,
+	std::vector<float>& depth) const
+{
+	//-- Same seed and frame number always give the same frame
+	std::mt19937 rng(seed * 2654435761u + unsigned(number));
+	std::uniform_real_distribution<float> uniform(0.0f, 1.0f);
+	std::normal_distribution<float> gaussian(0.0f, 1.0f);
+
+	const int width = intrinsics.width;
+	const int height = intrinsics.height;
+	const std::vector<float> clean = depth;
+
+	for (int v = 0; v < height; v++)
+	{
+		for (int u = 0; u < width; u++)
+		{
+			size_t i = size_t(v) * width + u;
+			float z = clean[i];
+			if (z <= 0.0f) { continue; }
+
+			//-- Occlusion shadow, the band of background the right imager can not see
+			if (noise.occlusionShadow && u > 0 && clean[i - 1] > z * (1.0f + noise.edgeJump))
+			{
+				float zFar = clean[i - 1];
+				int band = int(intrinsics.fx * noise.baseline * (1.0 / z - 1.0 / zFar) + 0.5);
+
+				for (int k = 1; k <= band && u - k >= 0; k++)
+				{
+					if (clean[i - k] > z) { depth[i - k] = 0.0f; }
+				}
+			}
+
+			//-- Flying pixels on depth edges mix foreground and background
+			float neighbor = (u + 1 < width) ? clean[i + 1] : z;
+			if (v + 1 < height && std::abs(clean[i + width] - z) > std::abs(neighbor - z)) { neighbor = clean[i + width]; }
+
+			if (neighbor > 0.0f && std::abs(neighbor - z) > noise.edgeJump * z && uniform(rng) < noise.flyingPixelRate)
+			{
+				float mix = uniform(rng);
+				z = z * (1.0f - mix) + neighbor * mix;
+			}
+
+			//-- Stereo depth error grows with the square of the distance
+			float sigma = float(z * z * noise.subpixel / (intrinsics.fx * noise.baseline));
+			z += sigma * gaussian(rng);
+
+			if (uniform(rng) < noise.holeRate || z < noise.minDepth || z > noise.maxDepth)
+			{
+				depth[i] = 0.0f;
+			}
+			else
+			{
+				depth[i] = z;
+			}
+		}
+	}
+}
+
+FieldSceneSource::FieldSceneSource(FieldSynthesizer& synthesizer, const DepthIntrinsics& intrinsics,
+	const CameraPose& start, double speed, double fps, size_t frameNum) :
+synthesizer(synthesizer),
+intrinsics(intrinsics),
+start(start),
+speed(speed),
+fps(fps),
+frameNum(frameNum),
+next(0)
+{
+
+}
+
+bool FieldSceneSource::grab(DepthFrame& frame)
+{
+	if (next >= frameNum) { return false; }
+
+	//-- Drive straight along the heading
+	CameraPose pose = start;
+	double travelled = speed * next / fps;
+	pose.x += travelled * sin(start.yaw * DEG_TO_RAD);
+	pose.z += travelled * cos(start.yaw * DEG_TO_RAD);
+
+	synthesizer.render(pose, intrinsics, next, frame);
+	frame.timestamp = next * 1000.0 / fps;
+	frame.arrival = hostClockMs();
+
+	next++;
+	return true;
+}
@@ -0,0 +1,125 @@
+#define _CRT_SECURE_NO_WARNINGS
+
+#ifndef FIELD_SYNTH_H_
+#define FIELD_SYNTH_H_
+
+#include <vector>
+#include <Eigen/Dense>
+#include "frame_source.h"
+
+//-- Field frame: x to the right, y up, z along the field, ground at y = 0
+
+//-- Camera pose on the field, angles in degree, pitch positive when looking down
+typedef struct
+{
+	double x;
+	double z;
+	double height;
+
+	double pitch;
+	double yaw;
+
+} CameraPose;
+
+//-- Layout of the field elements the locator looks for
+struct FieldLayout
+{
+	FieldLayout();
+
+	double leftFenseX;        /* inner face of the left fense */
+	double fenseHeight;
+	double fenseThickness;
+
+	bool   hasDune;
+	double duneZ;             /* foot of the near slope */
+	double duneXMin;
+	double duneXMax;
+	double duneHeight;
+	double duneSlope;         /* degree */
+	double duneTopWidth;
+
+	bool   hasFrontFense;
+	double frontFenseZ;       /* near face */
+	double frontFenseXMin;
+	double frontFenseXMax;
+
+	bool   hasGrassland;
+	double grasslandZMin;
+	double grasslandZMax;
+	double grassHeight;
+	double grassRoughness;
+};
+
+//-- Depth error model of the D435 stereo pair
+struct DepthNoiseModel
+{
+	DepthNoiseModel();
+
+	double subpixel;          /* disparity error in pixel, RMS depth error is z^2 * subpixel / (f * baseline) */
+	double baseline;          /* meter */
+	double holeRate;          /* random dropouts */
+	double edgeJump;          /* relative depth jump treated as an object edge */
+	double flyingPixelRate;   /* edge pixels mixed from both sides */
+	bool   occlusionShadow;   /* invalid band left of near objects, the left imager sees what the right one can not */
+
+	double minDepth;
+	double maxDepth;
+	double depthScale;
+};
+
+//-- Intrinsics of the D435 depth stream at 424x240, 640x480, 848x480 and 1280x720
+bool d435Intrinsics(int width, int height, DepthIntrinsics& intrinsics);
+
+//-- Ray casts organized Z16 depth frames of the field
+class FieldSynthesizer
+{
+public:
+	FieldSynthesizer(const FieldLayout& layout, const DepthNoiseModel& noise, unsigned int seed = 0);
+
+	void render(const CameraPose& pose, const DepthIntrinsics& intrinsics, unsigned long long number, DepthFrame& frame);
+
+private:
+	//-- Convex solid as intersection of half spaces normal . p <= offset
+	typedef struct
+	{
+		std::vector<Eigen::Vector4d> halfSpaces;
+		bool rough;
+
+	} Solid;
+
+	void addBox(Eigen::Vector3d minCorner, Eigen::Vector3d maxCorner, bool rough = false);
+	void addDune(void);
+
+	double castRay(const Eigen::Vector3d& origin, const Eigen::Vector3d& direction) const;
+
+	void applyNoise(const DepthIntrinsics& intrinsics, unsigned long long number, std::vector<float>& depth) const;
+
+private:
+	FieldLayout         layout;
+	DepthNoiseModel     noise;
+	unsigned int        seed;
+
+	std::vector<Solid>  solids;
+};
+
+//-- Camera driving over a synthetic field, fed like a recording
+class FieldSceneSource : public FrameSource
+{
+public:
+	FieldSceneSource(FieldSynthesizer& synthesizer, const DepthIntrinsics& intrinsics,
+		const CameraPose& start, double speed, double fps, size_t frameNum);
+
+	bool grab(DepthFrame& frame);
+
+private:
+	FieldSynthesizer&   synthesizer;
+	DepthIntrinsics     intrinsics;
+	CameraPose          start;
+
+	double              speed;      /* meter per second along the heading */
+	double              fps;
+	size_t              frameNum;
+	size_t              next;
+};
+
+#endif
@@ -0,0 +1,158 @@
+#include "flight_recorder.h"
+#include "thread_profile.h"
+#include <utility>
+
+FlightRecorder::FlightRecorder(FrameSource& source, size_t memoryBudget) :
+source(source),
+memoryBudget(memoryBudget),
+queuedBytes(0),
+dropped(0),
+quit(false)
+{
+
+}
+
+FlightRecorder::~FlightRecorder()
+{
+	close();
+}
+
+bool FlightRecorder::open(const std::string& path)
+{
+	if (!writer.open(path)) { return false; }
+
+	writer.setCodec(DEPTH_CODEC_RVL);
+	quit = false;
+	writerThread = std::thread(&FlightRecorder::writerLoop, this);
+	return true;
+}
+
+void FlightRecorder::close(void)
+{
+	if (!writerThread.joinable()) { return; }
+
+	{
+		std::lock_guard<std::mutex> lock(queueMutex);
+		quit = true;
+	}
+	queueReady.notify_one();
+	writerThread.join();
+
+	writer.close();
+}
+
+bool FlightRecorder::grab(DepthFrame& frame)
+{
+	if (!source.grab(frame)) { return false; }
+	if (!writerThread.joinable()) { return true; }
+
+	size_t bytes = frame.depth.size() * sizeof(uint16_t);
+	if (!reserve(bytes)) { return true; }
+
+	Entry entry;
+	entry.isFrame = true;
+	entry.frame.timestamp = frame.timestamp;
+	entry.frame.arrival = frame.arrival;
+	entry.frame.number = frame.number;
+	entry.frame.intrinsics = frame.intrinsics;
+
+	{
+		std::lock_guard<std::mutex> lock(queueMutex);
+		if (!spareBuffers.empty())
+		{
+			entry.frame.depth.swap(spareBuffers.back());
+			spareBuffers.pop_back();
+		}
+	}
+
+	//-- Plain copy into a buffer of the right capacity, compression happens on the writer
+	entry.frame.depth.assign(frame.depth.begin(), frame.depth.end());
+	push(entry);
+
+	return true;
+}
+
+void FlightRecorder::record(const LocateRecord& record)
+{
+	if (!writerThread.joinable() || !reserve(sizeof(record))) { return; }
+
+	Entry entry;
+	entry.isFrame = false;
+	entry.record = record;
+	push(entry);
+}
+
+size_t FlightRecorder::getDropped(void)
+{
+	std::lock_guard<std::mutex> lock(queueMutex);
+	return dropped;
+}
+
+bool FlightRecorder::reserve(size_t bytes)
+{
+	std::lock_guard<std::mutex> lock(queueMutex);
+
+	if (queuedBytes + bytes > memoryBudget)
+	{
+		dropped++;
+		return false;
+	}
+
+	queuedBytes += bytes;
+	return true;
+}
+
+void FlightRecorder::push(Entry& entry)
+{
+	{
+		std::lock_guard<std::mutex> lock(queueMutex);
+		queue.push_back(std::move(entry));
+	}
+	queueReady.notify_one();
+}
+
+void FlightRecorder::writerLoop(void)
+{
+	ThreadRoleScope role(THREAD_ROLE_BACKGROUND, "flight-writer");
+
+	Entry entry;
+
+	while (true)
+	{
+		{
+			std::unique_lock<std::mutex> lock(queueMutex);
+
+			//-- Flush while idle, a crash loses at most what is still queued
+			if (queue.empty() && !quit)
+			{
+				lock.unlock();
+				writer.flush();
+				lock.lock();
+			}
+
+			queueReady.wait(lock, [this]() { return quit || !queue.empty(); });
+			if (queue.empty()) { break; }
+
+			entry = std::move(queue.front());
+			queue.pop_front();
+		}
+
+		if (entry.isFrame) { writer.write(entry.frame); }
+		else { writer.write(entry.record); }
+
+		std::lock_guard<std::mutex> lock(queueMutex);
+
+		if (entry.isFrame)
+		{
+			queuedBytes -= entry.frame.depth.size() * sizeof(uint16_t);
+			spareBuffers.push_back(std::vector<uint16_t>());
+			spareBuffers.back().swap(entry.frame.depth);
+		}
+		else
+		{
+			queuedBytes -= sizeof(entry.record);
+		}
+	}
+
+	writer.flush();
+}
@@ -0,0 +1,69 @@
+#define _CRT_SECURE_NO_WARNINGS
+
+#ifndef FLIGHT_RECORDER_H_
+#define FLIGHT_RECORDER_H_
+
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "depth_sequence.h"
+
+//-- Frames and records waiting for the writer, about 100 frames at 640x480
+#define FLIGHT_MEMORY_BUDGET       (64u << 20)
+
+//-- Forwards frames of another source and records them with the locator states into an RVL compressed sequence
+//-- The grabbing thread only copies into recycled buffers, a background thread compresses and writes,
+//-- and whatever does not fit into the memory budget is dropped instead of stalling the locator
+class FlightRecorder : public FrameSource
+{
+public:
+	FlightRecorder(FrameSource& source, size_t memoryBudget = FLIGHT_MEMORY_BUDGET);
+	FlightRecorder(const FlightRecorder&) = delete;
+	FlightRecorder& operator=(const FlightRecorder&) = delete;
+	~FlightRecorder();
+
+	bool open(const std::string& path);
+
+	//-- Write everything still queued and stop the writer
+	void close(void);
+
+	bool grab(DepthFrame& frame);
+	void record(const LocateRecord& record);
+
+	size_t getDropped(void);
+
+private:
+	typedef struct
+	{
+		bool         isFrame;
+		DepthFrame   frame;
+		LocateRecord record;
+
+	} Entry;
+
+	bool reserve(size_t bytes);
+	void push(Entry& entry);
+
+	void writerLoop(void);
+
+private:
+	FrameSource&    source;
+	SequenceWriter  writer;
+	size_t          memoryBudget;
+
+	std::thread             writerThread;
+	std::mutex              queueMutex;
+	std::condition_variable queueReady;
+	std::deque<Entry>       queue;
+	size_t                  queuedBytes;
+	size_t                  dropped;
+	bool                    quit;
+
+	//-- Depth buffers handed back by the writer, so the grabbing thread does not allocate
+	std::vector<std::vector<uint16_t> > spareBuffers;
+};
+
+#endif
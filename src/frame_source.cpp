@@ -0,0 +1,387 @@
+#include "frame_source.h"
+#include <algorithm>
+#include <cstdlib>
+#include <chrono>
+#include <cmath>
+
+//-- Width the locator parameters were tuned at, automatic decimation stays at or below it
+#define TUNED_WIDTH 640
+
+//-- Largest decimation factor, same as rs2::decimation_filter
+#define MAX_DECIMATION 8
+
+static const CaptureProfile captureProfiles[] =
+{
+	{ "default",     640,  480, 30, 1, true  },
+	{ "low-latency", 848,  480, 90, 0, false },
+	{ "min-cpu",     424,  240, 90, 1, false },
+	{ "high-res",    1280, 720, 30, 0, false }
+};
+
+const CaptureProfile* findCaptureProfile(const std::string& name)
+{
+	for (size_t i = 0; i < sizeof(captureProfiles) / sizeof(captureProfiles[0]); i++)
+	{
+		if (name == captureProfiles[i].name) { return &captureProfiles[i]; }
+	}
+
+	return NULL;
+}
+
+std::vector<std::string> captureProfileNames(void)
+{
+	std::vector<std::string> names;
+
+	for (size_t i = 0; i < sizeof(captureProfiles) / sizeof(captureProfiles[0]); i++)
+	{
+		names.push_back(captureProfiles[i].name);
+	}
+
+	return names;
+}
+
+int resolveDecimation(int decimation, int width)
+{
+	if (decimation > 0) { return std::min(decimation, MAX_DECIMATION); }
+
+	int factor = 1;
+	while (width / factor > TUNED_WIDTH && factor < MAX_DECIMATION) { factor++; }
+
+	return factor;
+}
+
+double hostClockMs(void)
+{
+	return std::chrono::duration_cast<std::chrono::microseconds>(
+		std::chrono::system_clock::now().time_since_epoch()).count() / 1000.0;
+}
+
+//===================================================
+// decimateDepthFrame
+// - Shrinks the frame by factor in both directions
+// like rs2::decimation_filter, the median of the
+// valid pixels of each block for factor 2 and 3 and
+// their mean above, blocks without depth stay 0
+//===================================================
+void decimateDepthFrame(DepthFrame& frame, int factor)
+{
+	factor = std::min(factor, MAX_DECIMATION);
+	if (factor <= 1) { return; }
+
+	DepthIntrinsics& intrin = frame.intrinsics;
+	const int width = intrin.width / factor;
+	const int height = intrin.height / factor;
+
+	std::vector<uint16_t> decimated(size_t(width) * height);
+	uint16_t block[MAX_DECIMATION * MAX_DECIMATION];
+
+	for (int v = 0; v < height; v++)
+	{
+		for (int u = 0; u < width; u++)
+		{
+			int valid = 0;
+
+			for (int dv = 0; dv < factor; dv++)
+			{
+				const uint16_t* row = frame.depth.data() + size_t(v * factor + dv) * intrin.width + u * factor;
+
+				for (int du = 0; du < factor; du++)
+				{
+					if (row[du] != 0) { block[valid++] = row[du]; }
+				}
+			}
+
+			uint16_t value = 0;
+
+			if (valid > 0 && factor <= 3)
+			{
+				std::nth_element(block, block + valid / 2, block + valid);
+				value = block[valid / 2];
+			}
+			else if (valid > 0)
+			{
+				unsigned int sum = 0;
+				for (int i = 0; i < valid; i++) { sum += block[i]; }
+				value = uint16_t(sum / valid);
+			}
+
+			decimated[size_t(v) * width + u] = value;
+		}
+	}
+
+	//-- Pixel centers of the coarse grid sit in the middle of each block
+	intrin.width = width;
+	intrin.height = height;
+	intrin.fx /= factor;
+	intrin.fy /= factor;
+	intrin.ppx = (intrin.ppx + 0.5f) / factor - 0.5f;
+	intrin.ppy = (intrin.ppy + 0.5f) / factor - 0.5f;
+
+	frame.depth.swap(decimated);
+}
+
+//===================================================
+// depthChangeShare
+// - Holes come and go with the sensor noise, only
+// pixels with depth in both frames are compared
+//===================================================
+double depthChangeShare(const DepthFrame& frame, const std::vector<uint16_t>& reference, float change)
+{
+	if (reference.size() != frame.depth.size()) { return 1.0; }
+
+	//-- change * (units * scale)^2 meters, in depth units
+	const float bound = change * frame.intrinsics.depthScale;
+	size_t compared = 0, changed = 0;
+
+	for (size_t i = 0; i < reference.size(); i++)
+	{
+		const int now = frame.depth[i], before = reference[i];
+		if (now == 0 || before == 0) { continue; }
+
+		const float units = float(before);
+		compared++;
+		changed += (float(std::abs(now - before)) > bound * units * units) ? 1 : 0;
+	}
+
+	return (compared > 0) ? double(changed) / compared : 1.0;
+}
+
+//===================================================
+// deprojectDepthFrame
+// - Organized cloud in camera coordinates, pixels
+// without depth end up at the origin like the
+// output of rs2::pointcloud
+//===================================================
+template <typename PointT>
+void deprojectDepthFrame(const DepthFrame& frame, pcl::PointCloud<PointT>& cloud)
+{
+	const DepthIntrinsics& intrin = frame.intrinsics;
+
+	cloud.width = intrin.width;
+	cloud.height = intrin.height;
+	cloud.is_dense = false;
+	cloud.points.resize(size_t(intrin.width) * intrin.height);
+
+	const float invFx = 1.0f / intrin.fx;
+	const float invFy = 1.0f / intrin.fy;
+
+	const uint16_t* depth = frame.depth.data();
+	PointT* p = cloud.points.data();
+
+	for (int v = 0; v < intrin.height; v++)
+	{
+		const float rayY = (v - intrin.ppy) * invFy;
+
+		for (int u = 0; u < intrin.width; u++, depth++, p++)
+		{
+			const float z = *depth * intrin.depthScale;
+
+			p->x = (u - intrin.ppx) * invFx * z;
+			p->y = rayY * z;
+			p->z = z;
+		}
+	}
+}
+
+template void deprojectDepthFrame<pcl::PointXYZ>(const DepthFrame& frame, pcl::PointCloud<pcl::PointXYZ>& cloud);
+template void deprojectDepthFrame<pcl::PointXYZRGB>(const DepthFrame& frame, pcl::PointCloud<pcl::PointXYZRGB>& cloud);
+
+//-- Depth units at which slope * depth stays within [low, high], near > far if it never does
+static void depthRange(float slope, float low, float high, float maxDepth, float depthScale, int& nearUnits, int& farUnits)
+{
+	double nearDepth = 0.0, farDepth = std::min(double(maxDepth), 65535.0 * depthScale);
+
+	if (slope > 0.0f)
+	{
+		nearDepth = std::max(nearDepth, double(low) / slope);
+		farDepth = std::min(farDepth, double(high) / slope);
+	}
+	else if (slope < 0.0f)
+	{
+		nearDepth = std::max(nearDepth, double(high) / slope);
+		farDepth = std::min(farDepth, double(low) / slope);
+	}
+	else if (low > 0.0f || high < 0.0f)
+	{
+		farDepth = -1.0;
+	}
+
+	//-- Depth 0 means no depth, it never passes
+	nearUnits = std::max(1, int(std::ceil(nearDepth / depthScale)));
+	farUnits = (farDepth < 0.0) ? 0 : int(std::floor(farDepth / depthScale));
+}
+
+//===================================================
+// makeDepthWindow
+// - A pixel at depth d lands at x = d * (u - ppx) / fx
+// and, after leveling, at z = d * (sin(angle) *
+// (v - ppy) / fy + cos(angle)), so the box bounds
+// turn into a depth range per column and per row
+//===================================================
+void makeDepthWindow(const DepthIntrinsics& intrin, float angle, const float box[4], float margin, float maxDepth,
+	DepthWindow& window)
+{
+	const float sine = std::sin(angle);
+	const float cosine = std::cos(angle);
+
+	window.columnNear.resize(intrin.width);
+	window.columnFar.resize(intrin.width);
+	window.rowNear.resize(intrin.height);
+	window.rowFar.resize(intrin.height);
+
+	for (int u = 0; u < intrin.width; u++)
+	{
+		depthRange((u - intrin.ppx) / intrin.fx, box[0] - margin, box[1] + margin, maxDepth, intrin.depthScale,
+			window.columnNear[u], window.columnFar[u]);
+	}
+
+	for (int v = 0; v < intrin.height; v++)
+	{
+		depthRange(sine * (v - intrin.ppy) / intrin.fy + cosine, box[2] - margin, box[3] + margin, maxDepth, intrin.depthScale,
+			window.rowNear[v], window.rowFar[v]);
+	}
+
+	//-- Close to the camera every column reaches the x bounds, but no row the z bounds,
+	//-- so each side is cut to the depths the other one can take at all
+	int columnLow = 65536, columnHigh = 0, rowLow = 65536, rowHigh = 0;
+	for (int u = 0; u < intrin.width; u++)
+	{
+		if (window.columnNear[u] > window.columnFar[u]) { continue; }
+		columnLow = std::min(columnLow, window.columnNear[u]);
+		columnHigh = std::max(columnHigh, window.columnFar[u]);
+	}
+	for (int v = 0; v < intrin.height; v++)
+	{
+		if (window.rowNear[v] > window.rowFar[v]) { continue; }
+		rowLow = std::min(rowLow, window.rowNear[v]);
+		rowHigh = std::max(rowHigh, window.rowFar[v]);
+	}
+
+	window.uMin = intrin.width;
+	window.uMax = -1;
+	for (int u = 0; u < intrin.width; u++)
+	{
+		window.columnNear[u] = std::max(window.columnNear[u], rowLow);
+		window.columnFar[u] = std::min(window.columnFar[u], rowHigh);
+
+		if (window.columnNear[u] > window.columnFar[u]) { continue; }
+		window.uMin = std::min(window.uMin, u);
+		window.uMax = u;
+	}
+
+	window.vMin = intrin.height;
+	window.vMax = -1;
+	for (int v = 0; v < intrin.height; v++)
+	{
+		window.rowNear[v] = std::max(window.rowNear[v], columnLow);
+		window.rowFar[v] = std::min(window.rowFar[v], columnHigh);
+
+		if (window.rowNear[v] > window.rowFar[v]) { continue; }
+		window.vMin = std::min(window.vMin, v);
+		window.vMax = v;
+	}
+}
+
+template <typename PointT>
+void deprojectDepthSample(const DepthFrame& frame, int step, pcl::PointCloud<PointT>& cloud)
+{
+	const DepthIntrinsics& intrin = frame.intrinsics;
+	step = std::max(1, step);
+
+	cloud.points.clear();
+	cloud.points.reserve(size_t(intrin.width / step + 1) * (intrin.height / step + 1));
+
+	const float invFx = 1.0f / intrin.fx;
+	const float invFy = 1.0f / intrin.fy;
+
+	for (int v = 0; v < intrin.height; v += step)
+	{
+		const float rayY = (v - intrin.ppy) * invFy;
+		const uint16_t* depth = frame.depth.data() + size_t(v) * intrin.width;
+
+		for (int u = 0; u < intrin.width; u += step)
+		{
+			if (depth[u] == 0) { continue; }
+
+			const float z = depth[u] * intrin.depthScale;
+
+			PointT p;
+			p.x = (u - intrin.ppx) * invFx * z;
+			p.y = rayY * z;
+			p.z = z;
+			cloud.points.push_back(p);
+		}
+	}
+
+	cloud.width = uint32_t(cloud.points.size());
+	cloud.height = 1;
+	cloud.is_dense = true;
+}
+
+template void deprojectDepthSample<pcl::PointXYZ>(const DepthFrame& frame, int step, pcl::PointCloud<pcl::PointXYZ>& cloud);
+template void deprojectDepthSample<pcl::PointXYZRGB>(const DepthFrame& frame, int step, pcl::PointCloud<pcl::PointXYZRGB>& cloud);
+
+//===================================================
+// deprojectDepthWindows
+// - Visits only the rows and columns of the union of
+// the windows, a pixel is kept if its depth is in
+// the column and the row range of one of them
+//===================================================
+template <typename PointT>
+void deprojectDepthWindows(const DepthFrame& frame, const DepthWindows& windows, pcl::PointCloud<PointT>& cloud)
+{
+	const DepthIntrinsics& intrin = frame.intrinsics;
+
+	int uMin = intrin.width, uMax = -1, vMin = intrin.height, vMax = -1;
+	for (size_t w = 0; w < windows.size(); w++)
+	{
+		uMin = std::min(uMin, windows[w].uMin);
+		uMax = std::max(uMax, windows[w].uMax);
+		vMin = std::min(vMin, windows[w].vMin);
+		vMax = std::max(vMax, windows[w].vMax);
+	}
+
+	cloud.points.clear();
+	if (uMin <= uMax && vMin <= vMax) { cloud.points.reserve(size_t(uMax - uMin + 1) * (vMax - vMin + 1)); }
+
+	const float invFx = 1.0f / intrin.fx;
+	const float invFy = 1.0f / intrin.fy;
+
+	for (int v = vMin; v <= vMax; v++)
+	{
+		const float rayY = (v - intrin.ppy) * invFy;
+		const uint16_t* depth = frame.depth.data() + size_t(v) * intrin.width;
+
+		for (int u = uMin; u <= uMax; u++)
+		{
+			const int units = depth[u];
+			bool inside = false;
+
+			for (size_t w = 0; w < windows.size() && !inside; w++)
+			{
+				const DepthWindow& window = windows[w];
+
+				inside = window.rowNear[v] <= units && units <= window.rowFar[v] &&
+					window.columnNear[u] <= units && units <= window.columnFar[u];
+			}
+			if (!inside) { continue; }
+
+			const float z = units * intrin.depthScale;
+
+			PointT p;
+			p.x = (u - intrin.ppx) * invFx * z;
+			p.y = rayY * z;
+			p.z = z;
+			cloud.points.push_back(p);
+		}
+	}
+
+	cloud.width = uint32_t(cloud.points.size());
+	cloud.height = 1;
+	cloud.is_dense = true;
+}
+
+template void deprojectDepthWindows<pcl::PointXYZ>(const DepthFrame& frame, const DepthWindows& windows,
+	pcl::PointCloud<pcl::PointXYZ>& cloud);
+template void deprojectDepthWindows<pcl::PointXYZRGB>(const DepthFrame& frame, const DepthWindows& windows,
+	pcl::PointCloud<pcl::PointXYZRGB>& cloud);
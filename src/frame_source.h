@@ -0,0 +1,112 @@
+#define _CRT_SECURE_NO_WARNINGS
+
+#ifndef FRAME_SOURCE_H_
+#define FRAME_SOURCE_H_
+
+#include <string>
+#include <vector>
+#include <stdint.h>
+#include <pcl/point_types.h>
+#include <pcl/point_cloud.h>
+
+//-- Pinhole model of a depth stream
+typedef struct
+{
+	int width;
+	int height;
+
+	float fx;
+	float fy;
+	float ppx;
+	float ppy;
+
+	float depthScale;   /* meters per depth unit */
+
+} DepthIntrinsics;
+
+//-- One Z16 depth frame with everything needed to deproject it
+typedef struct
+{
+	double              timestamp;   /* milliseconds */
+	double              arrival;     /* host clock when the frame reached the process, see hostClockMs() */
+	unsigned long long  number;
+
+	DepthIntrinsics     intrinsics;
+	std::vector<uint16_t> depth;
+
+} DepthFrame;
+
+//-- Anything delivering depth frames, the camera or a recording
+class FrameSource
+{
+public:
+	virtual ~FrameSource() {}
+
+	//-- Return false once no more frames are available
+	virtual bool grab(DepthFrame& frame) = 0;
+};
+
+//-- Named resolution and frame rate of the camera
+typedef struct
+{
+	const char* name;
+
+	int width;
+	int height;
+	int fps;
+
+	int decimation;      /* depth decimation factor, 0 picks one from the resolution */
+	bool alignToColor;   /* align depth to a color stream of the same mode */
+
+} CaptureProfile;
+
+const CaptureProfile* findCaptureProfile(const std::string& name);
+
+std::vector<std::string> captureProfileNames(void);
+
+//-- Decimation factor used for a depth stream of the given width, resolves the automatic one
+int resolveDecimation(int decimation, int width);
+
+//-- Milliseconds of the system clock, the domain of the librealsense arrival time
+double hostClockMs(void);
+
+void decimateDepthFrame(DepthFrame& frame, int factor);
+
+//-- Share of the pixels with depth in both frames whose depth moved further than change, in meters at 1 m
+//-- The bound grows with the square of the depth like the stereo error, 1 if the frames differ in size
+double depthChangeShare(const DepthFrame& frame, const std::vector<uint16_t>& reference, float change);
+
+//-- Instantiated for pcl::PointXYZ and pcl::PointXYZRGB
+template <typename PointT>
+void deprojectDepthFrame(const DepthFrame& frame, pcl::PointCloud<PointT>& cloud);
+
+//-- Pixels which can land in an x-z box of the leveled camera frame, unbounded in height
+//-- x only depends on the column and the leveled z only on the row, so each gets a depth range
+typedef struct
+{
+	int uMin, uMax;                     /* pixel window, inclusive, empty if min > max */
+	int vMin, vMax;
+
+	std::vector<int> columnNear;        /* depth units, per column */
+	std::vector<int> columnFar;
+	std::vector<int> rowNear;           /* depth units, per row */
+	std::vector<int> rowFar;
+
+} DepthWindow;
+
+typedef std::vector<DepthWindow> DepthWindows;
+
+//-- box is xMin, xMax, zMin, zMax after leveling by angle about the x-axis, grown by margin on every side
+//-- Pixels beyond maxDepth in meters never pass
+void makeDepthWindow(const DepthIntrinsics& intrin, float angle, const float box[4], float margin, float maxDepth,
+	DepthWindow& window);
+
+//-- Unorganized cloud of every step-th pixel of every step-th row, pixels without depth are left out
+template <typename PointT>
+void deprojectDepthSample(const DepthFrame& frame, int step, pcl::PointCloud<PointT>& cloud);
+
+//-- Unorganized cloud of the pixels inside any of the windows, pixels without depth are left out
+template <typename PointT>
+void deprojectDepthWindows(const DepthFrame& frame, const DepthWindows& windows, pcl::PointCloud<PointT>& cloud);
+
+#endif
@@ -0,0 +1,240 @@
+#include "geometry_kernels.h"
+#include <cmath>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define KERNEL_WIDTH 8
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define KERNEL_WIDTH 4
+#else
+#define KERNEL_WIDTH 1
+#endif
+
+static inline const float* record(const float* data, size_t stride, const int* indices, size_t i)
+{
+	return data + (indices ? size_t(indices[i]) : i) * stride;
+}
+
+static inline void writeBits(int bits, int width, uint8_t* flags)
+{
+	for (int k = 0; k < width; k++) { flags[k] = uint8_t((bits >> k) & 1); }
+}
+
+#if KERNEL_WIDTH == 8
+
+//-- Two 4x4 transposes, one per 128 bit lane, lane 0 holds records i..i+3 and lane 1 records i+4..i+7
+static inline void loadXYZ(const float* data, size_t stride, const int* indices, size_t i, __m256& x, __m256& y, __m256& z)
+{
+	__m256 r[4];
+	for (int k = 0; k < 4; k++)
+	{
+		r[k] = _mm256_insertf128_ps(_mm256_castps128_ps256(_mm_loadu_ps(record(data, stride, indices, i + k))),
+			_mm_loadu_ps(record(data, stride, indices, i + k + 4)), 1);
+	}
+
+	__m256 t0 = _mm256_unpacklo_ps(r[0], r[1]);   /* x0 x1 y0 y1 */
+	__m256 t1 = _mm256_unpacklo_ps(r[2], r[3]);   /* x2 x3 y2 y3 */
+	__m256 t2 = _mm256_unpackhi_ps(r[0], r[1]);   /* z0 z1 w0 w1 */
+	__m256 t3 = _mm256_unpackhi_ps(r[2], r[3]);   /* z2 z3 w2 w3 */
+
+	x = _mm256_shuffle_ps(t0, t1, _MM_SHUFFLE(1, 0, 1, 0));
+	y = _mm256_shuffle_ps(t0, t1, _MM_SHUFFLE(3, 2, 3, 2));
+	z = _mm256_shuffle_ps(t2, t3, _MM_SHUFFLE(1, 0, 1, 0));
+}
+
+typedef __m256 Lanes;
+
+static inline Lanes splat(float value) { return _mm256_set1_ps(value); }
+static inline Lanes add(Lanes a, Lanes b) { return _mm256_add_ps(a, b); }
+static inline Lanes mul(Lanes a, Lanes b) { return _mm256_mul_ps(a, b); }
+static inline Lanes absolute(Lanes a) { return _mm256_andnot_ps(_mm256_set1_ps(-0.0f), a); }
+static inline Lanes less(Lanes a, Lanes b) { return _mm256_cmp_ps(a, b, _CMP_LT_OQ); }
+static inline Lanes lessEqual(Lanes a, Lanes b) { return _mm256_cmp_ps(a, b, _CMP_LE_OQ); }
+static inline Lanes both(Lanes a, Lanes b) { return _mm256_and_ps(a, b); }
+static inline int bitsOf(Lanes a) { return _mm256_movemask_ps(a); }
+static inline void store(float* out, Lanes a) { _mm256_storeu_ps(out, a); }
+
+#elif KERNEL_WIDTH == 4
+
+static inline void loadXYZ(const float* data, size_t stride, const int* indices, size_t i, __m128& x, __m128& y, __m128& z)
+{
+	__m128 r0 = _mm_loadu_ps(record(data, stride, indices, i));
+	__m128 r1 = _mm_loadu_ps(record(data, stride, indices, i + 1));
+	__m128 r2 = _mm_loadu_ps(record(data, stride, indices, i + 2));
+	__m128 r3 = _mm_loadu_ps(record(data, stride, indices, i + 3));
+
+	_MM_TRANSPOSE4_PS(r0, r1, r2, r3);
+
+	x = r0;
+	y = r1;
+	z = r2;
+}
+
+typedef __m128 Lanes;
+
+static inline Lanes splat(float value) { return _mm_set1_ps(value); }
+static inline Lanes add(Lanes a, Lanes b) { return _mm_add_ps(a, b); }
+static inline Lanes mul(Lanes a, Lanes b) { return _mm_mul_ps(a, b); }
+static inline Lanes absolute(Lanes a) { return _mm_andnot_ps(_mm_set1_ps(-0.0f), a); }
+static inline Lanes less(Lanes a, Lanes b) { return _mm_cmplt_ps(a, b); }
+static inline Lanes lessEqual(Lanes a, Lanes b) { return _mm_cmple_ps(a, b); }
+static inline Lanes both(Lanes a, Lanes b) { return _mm_and_ps(a, b); }
+static inline int bitsOf(Lanes a) { return _mm_movemask_ps(a); }
+static inline void store(float* out, Lanes a) { _mm_storeu_ps(out, a); }
+
+#endif
+
+//-- Runs a predicate over full blocks of lanes, the rest one record at a time with the same arithmetic
+template <typename Predicate>
+static void runMask(const float* data, size_t stride, const int* indices, size_t count,
+	const Predicate& predicate, uint8_t* flags)
+{
+	size_t i = 0;
+
+#if KERNEL_WIDTH > 1
+	for (; i + KERNEL_WIDTH <= count; i += KERNEL_WIDTH)
+	{
+		Lanes x, y, z;
+		loadXYZ(data, stride, indices, i, x, y, z);
+		writeBits(bitsOf(predicate.test(x, y, z)), KERNEL_WIDTH, flags + i);
+	}
+#endif
+
+	for (; i < count; i++)
+	{
+		const float* p = record(data, stride, indices, i);
+		flags[i] = predicate.test(p[0], p[1], p[2]) ? 1 : 0;
+	}
+}
+
+//-- Each predicate is written once for float and for the lanes, in the same order of operations
+struct CosinePredicate
+{
+	float a, b, c, cosine;
+	bool  above;
+
+	bool test(float x, float y, float z) const
+	{
+		float value = std::fabs(a * x + b * y + c * z);
+		return above ? cosine < value : value < cosine;
+	}
+
+#if KERNEL_WIDTH > 1
+	Lanes test(Lanes x, Lanes y, Lanes z) const
+	{
+		Lanes value = absolute(add(add(mul(splat(a), x), mul(splat(b), y)), mul(splat(c), z)));
+		return above ? less(splat(cosine), value) : less(value, splat(cosine));
+	}
+#endif
+};
+
+struct DistancePredicate
+{
+	float a, b, c, d, distance;
+	bool  above;
+
+	bool test(float x, float y, float z) const
+	{
+		float value = std::fabs(a * x + b * y + c * z + d);
+		return above ? distance < value : value < distance;
+	}
+
+#if KERNEL_WIDTH > 1
+	Lanes test(Lanes x, Lanes y, Lanes z) const
+	{
+		Lanes value = absolute(add(add(add(mul(splat(a), x), mul(splat(b), y)), mul(splat(c), z)), splat(d)));
+		return above ? less(splat(distance), value) : less(value, splat(distance));
+	}
+#endif
+};
+
+struct BoxPredicate
+{
+	float xMin, xMax, zMin, zMax;
+
+	bool test(float x, float, float z) const
+	{
+		return xMin <= x && x <= xMax && zMin <= z && z <= zMax;
+	}
+
+#if KERNEL_WIDTH > 1
+	Lanes test(Lanes x, Lanes, Lanes z) const
+	{
+		return both(both(lessEqual(splat(xMin), x), lessEqual(x, splat(xMax))),
+			both(lessEqual(splat(zMin), z), lessEqual(z, splat(zMax))));
+	}
+#endif
+};
+
+void normalizePlane(const float coefficients[4], float plane[4])
+{
+	float norm = std::sqrt(coefficients[0] * coefficients[0] + coefficients[1] * coefficients[1] +
+		coefficients[2] * coefficients[2]);
+
+	for (int i = 0; i < 4; i++) { plane[i] = (norm > 0.0f) ? coefficients[i] / norm : 0.0f; }
+}
+
+void cosineMask(const float* vectors, size_t stride, const int* indices, size_t count,
+	const float axis[3], float cosine, bool above, uint8_t* flags)
+{
+	CosinePredicate predicate = { axis[0], axis[1], axis[2], cosine, above };
+	runMask(vectors, stride, indices, count, predicate, flags);
+}
+
+void distanceMask(const float* points, size_t stride, const int* indices, size_t count,
+	const float plane[4], float distance, bool above, uint8_t* flags)
+{
+	DistancePredicate predicate = { plane[0], plane[1], plane[2], plane[3], distance, above };
+	runMask(points, stride, indices, count, predicate, flags);
+}
+
+void boxMask(const float* points, size_t stride, const int* indices, size_t count,
+	const float box[4], uint8_t* flags)
+{
+	BoxPredicate predicate = { box[0], box[1], box[2], box[3] };
+	runMask(points, stride, indices, count, predicate, flags);
+}
+
+void planeDistance(const float* points, size_t stride, const int* indices, size_t count,
+	const float plane[4], float* distances)
+{
+	size_t i = 0;
+
+#if KERNEL_WIDTH > 1
+	for (; i + KERNEL_WIDTH <= count; i += KERNEL_WIDTH)
+	{
+		Lanes x, y, z;
+		loadXYZ(points, stride, indices, i, x, y, z);
+		store(distances + i, add(add(add(mul(splat(plane[0]), x), mul(splat(plane[1]), y)), mul(splat(plane[2]), z)),
+			splat(plane[3])));
+	}
+#endif
+
+	for (; i < count; i++)
+	{
+		const float* p = record(points, stride, indices, i);
+		distances[i] = plane[0] * p[0] + plane[1] * p[1] + plane[2] * p[2] + plane[3];
+	}
+}
+
+void maskAnd(uint8_t* flags, const uint8_t* other, size_t count)
+{
+	for (size_t i = 0; i < count; i++) { flags[i] &= other[i]; }
+}
+
+void maskOr(uint8_t* flags, const uint8_t* other, size_t count)
+{
+	for (size_t i = 0; i < count; i++) { flags[i] |= other[i]; }
+}
+
+const char* kernelInstructionSet(void)
+{
+#if KERNEL_WIDTH == 8
+	return "AVX2";
+#elif KERNEL_WIDTH == 4
+	return "SSE2";
+#else
+	return "scalar";
+#endif
+}
@@ -0,0 +1,40 @@
+#define _CRT_SECURE_NO_WARNINGS
+
+#ifndef GEOMETRY_KERNELS_H_
+#define GEOMETRY_KERNELS_H_
+
+#include <cstddef>
+#include <stdint.h>
+
+//-- Per-point predicates of the locator, evaluated 8 points per instruction with AVX2 (LOCATOR_AVX2),
+//-- 4 with SSE2 and one at a time elsewhere, every path gives the same flags
+//-- Points and normals are read as x, y, z from the start of records of stride floats, the layout of PCL points
+//-- indices picks the records to test if not NULL, flags[i] is set to 1 or 0 for the i-th tested record
+//-- Comparisons are ordered, NaN coordinates fail every test like they do in scalar code
+
+//-- Unit normal and offset of the plane a x + b y + c z + d = 0, zero if the normal is degenerate
+void normalizePlane(const float coefficients[4], float plane[4]);
+
+//-- |axis . v| < cosine, or > cosine if above, axis is a unit vector
+void cosineMask(const float* vectors, size_t stride, const int* indices, size_t count,
+	const float axis[3], float cosine, bool above, uint8_t* flags);
+
+//-- |plane . p| < distance, or > distance if above, plane is normalized
+void distanceMask(const float* points, size_t stride, const int* indices, size_t count,
+	const float plane[4], float distance, bool above, uint8_t* flags);
+
+//-- xMin <= x <= xMax and zMin <= z <= zMax, box is { xMin, xMax, zMin, zMax }
+void boxMask(const float* points, size_t stride, const int* indices, size_t count,
+	const float box[4], uint8_t* flags);
+
+//-- Signed distance plane . p of the records, plane is normalized
+void planeDistance(const float* points, size_t stride, const int* indices, size_t count,
+	const float plane[4], float* distances);
+
+void maskAnd(uint8_t* flags, const uint8_t* other, size_t count);
+void maskOr(uint8_t* flags, const uint8_t* other, size_t count);
+
+//-- Name of the instruction set the kernels were built for
+const char* kernelInstructionSet(void);
+
+#endif
@@ -0,0 +1,73 @@
+#include "ground_calibration.h"
+#include <fstream>
+#include <sstream>
+
+bool loadGroundCalibration(const std::string& path, GroundCalibration& calibration)
+{
+	std::ifstream file(path.c_str());
+	if (!file.is_open()) { return false; }
+
+	bool hasStream = false;
+	bool hasGround = false;
+	calibration.extrinsics.clear();
+
+	std::string line;
+	while (std::getline(file, line))
+	{
+		//-- Blank lines and comments
+		size_t first = line.find_first_not_of(" \t\r");
+		if (first == std::string::npos || line[first] == '#') { continue; }
+
+		std::istringstream fields(line);
+		std::string key;
+		fields >> key;
+
+		if (key == "stream")
+		{
+			if (!(fields >> calibration.width >> calibration.height)) { return false; }
+			hasStream = true;
+		}
+		else if (key == "ground")
+		{
+			if (!(fields >> calibration.ground[0] >> calibration.ground[1] >> calibration.ground[2] >> calibration.ground[3]
+				>> calibration.inlierShare)) { return false; }
+			hasGround = true;
+		}
+		else if (key == "camera")
+		{
+			Eigen::Matrix4f extrinsics;
+			for (int i = 0; i < 16; i++)
+			{
+				if (!(fields >> extrinsics(i / 4, i % 4))) { return false; }
+			}
+			calibration.extrinsics.push_back(extrinsics);
+		}
+		else
+		{
+			return false;
+		}
+	}
+
+	return hasStream && hasGround && !calibration.extrinsics.empty();
+}
+
+bool saveGroundCalibration(const std::string& path, const GroundCalibration& calibration)
+{
+	std::ofstream file(path.c_str(), std::ios::trunc);
+	if (!file.is_open()) { return false; }
+
+	file.precision(9);
+	file << "# Ground calibration, written by the locator after a full start\n";
+	file << "stream " << calibration.width << " " << calibration.height << "\n";
+	file << "ground " << calibration.ground[0] << " " << calibration.ground[1] << " " << calibration.ground[2] << " "
+		<< calibration.ground[3] << " " << calibration.inlierShare << "\n";
+
+	for (size_t c = 0; c < calibration.extrinsics.size(); c++)
+	{
+		file << "camera";
+		for (int i = 0; i < 16; i++) { file << " " << calibration.extrinsics[c](i / 4, i % 4); }
+		file << "\n";
+	}
+
+	return file.good();
+}
@@ -0,0 +1,29 @@
+#define _CRT_SECURE_NO_WARNINGS
+
+#ifndef GROUND_CALIBRATION_H_
+#define GROUND_CALIBRATION_H_
+
+#include <string>
+#include <vector>
+#include <Eigen/Dense>
+
+//-- Ground plane of the last validated start, saved so the next start can skip the ground fits
+//-- Text file of lines "stream <width> <height>", "ground <a> <b> <c> <d> <inlier share>"
+//-- and one "camera <m00> ... <m33>" per mounted camera, row major
+typedef struct
+{
+	int width;
+	int height;
+
+	float ground[4];         /* plane in the frame of the first camera */
+	float inlierShare;       /* share of the filtered first frame on the plane when it was saved */
+
+	std::vector<Eigen::Matrix4f, Eigen::aligned_allocator<Eigen::Matrix4f> > extrinsics;
+
+} GroundCalibration;
+
+bool loadGroundCalibration(const std::string& path, GroundCalibration& calibration);
+
+bool saveGroundCalibration(const std::string& path, const GroundCalibration& calibration);
+
+#endif
@@ -0,0 +1,182 @@
+#define _CRT_SECURE_NO_WARNINGS
+
+#ifndef GROUND_ESTIMATOR_H_
+#define GROUND_ESTIMATOR_H_
+
+#include <algorithm>
+#include <cmath>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <pcl/point_types.h>
+#include <pcl/point_cloud.h>
+#include <pcl/sample_consensus/method_types.h>
+#include <pcl/sample_consensus/model_types.h>
+#include <pcl/segmentation/sac_segmentation.h>
+#include "locator_params.h"
+#include "thread_profile.h"
+
+//-- Ground plane with everything derived from it, only changes as fast as the robot tilts
+typedef struct
+{
+	float coefficients[4];        /* ground in the camera frame */
+	float rotated[4];             /* ground after leveling about the x-axis */
+	float angle;                  /* leveling rotation about the x-axis, radian */
+	double cameraHeight;
+
+	unsigned long long number;    /* frame the plane was fitted on */
+
+} GroundSnapshot;
+
+inline void makeGroundSnapshot(const float coefficients[4], unsigned long long number, GroundSnapshot& snapshot)
+{
+	float norm = std::sqrt(coefficients[0] * coefficients[0] + coefficients[1] * coefficients[1] + coefficients[2] * coefficients[2]);
+
+	for (int i = 0; i < 4; i++) { snapshot.coefficients[i] = coefficients[i]; }
+
+	//-- Leveling turns the normal into the y-z plane onto the y-axis, x and the offset stay
+	snapshot.rotated[0] = coefficients[0];
+	snapshot.rotated[1] = -norm * (coefficients[3] / std::fabs(coefficients[3]));
+	snapshot.rotated[2] = 0.0f;
+	snapshot.rotated[3] = coefficients[3];
+
+	snapshot.angle = float(std::atan(-coefficients[2] / coefficients[1]));
+	snapshot.cameraHeight = std::fabs(snapshot.rotated[3]) / std::sqrt(snapshot.rotated[0] * snapshot.rotated[0] +
+		snapshot.rotated[1] * snapshot.rotated[1]);
+	snapshot.number = number;
+}
+
+//-- A new fit only replaces the ground if it is close to the last one, anything else is a wall or a glitch
+inline bool groundFitAgrees(const float* last, const float* fit, const LocatorParams& params)
+{
+	double lastNorm = std::sqrt(double(last[0]) * last[0] + double(last[1]) * last[1] + double(last[2]) * last[2]);
+	double fitNorm = std::sqrt(double(fit[0]) * fit[0] + double(fit[1]) * fit[1] + double(fit[2]) * fit[2]);
+
+	double angleCosine = std::fabs((double(last[0]) * fit[0] + double(last[1]) * fit[1] + double(last[2]) * fit[2]) /
+		(lastNorm * fitNorm));
+	double distDifference = std::fabs(fit[3] / fitNorm - last[3] / lastNorm);
+
+	return angleCosine > params.groundCosine && distDifference < params.groundDistDiff;
+}
+
+//-- Refits the ground on its own thread at groundRate, on every groundSubsample-th point of the offered frames
+//-- The frame thread copies the latest snapshot once per frame and never waits for a refit, a refit swaps in a new one
+template <typename PointT>
+class GroundEstimator
+{
+public:
+	typedef pcl::PointCloud<PointT> Cloud;
+	typedef typename Cloud::Ptr     CloudPtr;
+
+	GroundEstimator() : pendingNumber(0), quit(false), lastOffer(0.0) {}
+	GroundEstimator(const GroundEstimator&) = delete;
+	GroundEstimator& operator=(const GroundEstimator&) = delete;
+	~GroundEstimator() { stop(); }
+
+	void start(const LocatorParams& params, const GroundSnapshot& initial)
+	{
+		this->params = params;
+		std::atomic_store(&current, std::shared_ptr<const GroundSnapshot>(new GroundSnapshot(initial)));
+
+		quit = false;
+		lastOffer = -1e9;
+		worker = std::thread(&GroundEstimator::estimateLoop, this);
+	}
+
+	void stop(void)
+	{
+		if (!worker.joinable()) { return; }
+
+		{
+			std::lock_guard<std::mutex> lock(pendingMutex);
+			quit = true;
+		}
+		pendingReady.notify_one();
+		worker.join();
+	}
+
+	inline bool isRunning(void) const { return worker.joinable(); }
+
+	//-- Takes a sample of the frame if the last one is older than one refit interval, now in milliseconds
+	void offer(const Cloud& cloud, unsigned long long number, double now)
+	{
+		if (now - lastOffer < 1000.0 / params.groundRate) { return; }
+		lastOffer = now;
+
+		size_t step = size_t(std::max(1, params.groundSubsample));
+		CloudPtr sample(new Cloud);
+		sample->points.reserve(cloud.points.size() / step + 1);
+
+		for (size_t i = 0; i < cloud.points.size(); i += step) { sample->points.push_back(cloud.points[i]); }
+		sample->width = uint32_t(sample->points.size());
+		sample->height = 1;
+
+		{
+			std::lock_guard<std::mutex> lock(pendingMutex);
+			pending = sample;
+			pendingNumber = number;
+		}
+		pendingReady.notify_one();
+	}
+
+	//-- Not lock free, libstdc++ guards atomic shared_ptr access with a mutex of a small pool held for the pointer copy only
+	inline std::shared_ptr<const GroundSnapshot> snapshot(void) const { return std::atomic_load(&current); }
+
+private:
+	void estimateLoop(void)
+	{
+		ThreadRoleScope role(THREAD_ROLE_BACKGROUND, "ground");
+
+		while (true)
+		{
+			CloudPtr cloud;
+			unsigned long long number;
+
+			{
+				std::unique_lock<std::mutex> lock(pendingMutex);
+				pendingReady.wait(lock, [this]() { return quit || pending; });
+				if (quit) { break; }
+
+				cloud.swap(pending);
+				number = pendingNumber;
+			}
+
+			pcl::ModelCoefficients coefficients;
+			pcl::PointIndices inliers;
+
+			pcl::SACSegmentation<PointT> seg;
+			seg.setOptimizeCoefficients(true);
+			seg.setModelType(pcl::SACMODEL_PLANE);
+			seg.setMethodType(pcl::SAC_RANSAC);
+			seg.setDistanceThreshold(params.ransacThreshold);
+			seg.setMaxIterations(params.ransacMaxIterations);
+
+			seg.setInputCloud(cloud);
+			seg.segment(inliers, coefficients);
+
+			if (coefficients.values.size() != 4) { continue; }
+			if (!groundFitAgrees(snapshot()->coefficients, coefficients.values.data(), params)) { continue; }
+
+			GroundSnapshot* next = new GroundSnapshot;
+			makeGroundSnapshot(coefficients.values.data(), number, *next);
+			std::atomic_store(&current, std::shared_ptr<const GroundSnapshot>(next));
+		}
+	}
+
+private:
+	LocatorParams           params;
+	std::thread             worker;
+
+	std::mutex              pendingMutex;
+	std::condition_variable pendingReady;
+	CloudPtr                pending;
+	unsigned long long      pendingNumber;
+	bool                    quit;
+
+	double                  lastOffer;      /* only touched by the frame thread */
+
+	std::shared_ptr<const GroundSnapshot> current;
+};
+
+#endif
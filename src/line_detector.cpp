@@ -0,0 +1,213 @@
+#include "line_detector.h"
+#include <cmath>
+#include <stdint.h>
+#include <vector>
+#include <Eigen/Dense>
+
+static inline const float* record(const float* data, size_t stride, const int* indices, size_t i)
+{
+	return data + (indices ? size_t(indices[i]) : i) * stride;
+}
+
+//-- Fixed seed, the regression and the sweep need the same fit on every run
+static inline uint32_t nextRandom(uint32_t& state)
+{
+	state ^= state << 13;
+	state ^= state >> 17;
+	state ^= state << 5;
+	return state;
+}
+
+//-- Contiguous coordinates and no branches, the compiler vectorizes the loop
+static size_t countNearLine(const float* xs, const float* zs, size_t count, const float line[3], float threshold)
+{
+	const float a = line[0], c = line[1], d = line[2];
+	size_t near = 0;
+
+	for (size_t i = 0; i < count; i++) { near += (std::fabs(a * xs[i] + c * zs[i] + d) < threshold) ? 1 : 0; }
+
+	return near;
+}
+
+//-- Total least squares line through the points within threshold of the given one
+static void refineLine(const float* xs, const float* zs, size_t count, float threshold, float line[3])
+{
+	double n = 0.0, sumX = 0.0, sumZ = 0.0;
+
+	for (size_t i = 0; i < count; i++)
+	{
+		if (std::fabs(line[0] * xs[i] + line[1] * zs[i] + line[2]) < threshold)
+		{
+			n += 1.0;
+			sumX += xs[i];
+			sumZ += zs[i];
+		}
+	}
+
+	if (n < 2.0) { return; }
+
+	double centerX = sumX / n, centerZ = sumZ / n;
+	double xx = 0.0, zz = 0.0, xz = 0.0;
+
+	for (size_t i = 0; i < count; i++)
+	{
+		if (std::fabs(line[0] * xs[i] + line[1] * zs[i] + line[2]) < threshold)
+		{
+			double dx = xs[i] - centerX, dz = zs[i] - centerZ;
+			xx += dx * dx;
+			zz += dz * dz;
+			xz += dx * dz;
+		}
+	}
+
+	//-- Direction of the largest spread, the normal is perpendicular to it
+	double theta = 0.5 * std::atan2(2.0 * xz, xx - zz);
+	double a = -std::sin(theta), c = std::cos(theta);
+
+	line[0] = float(a);
+	line[1] = float(c);
+	line[2] = float(-(a * centerX + c * centerZ));
+}
+
+size_t fitTraceLine(const float* points, size_t stride, const int* indices, size_t count,
+	float threshold, int iterations, float line[3])
+{
+	if (count < 2) { return 0; }
+
+	//-- Project onto the x-z plane
+	std::vector<float> xs(count), zs(count);
+	for (size_t i = 0; i < count; i++)
+	{
+		const float* p = record(points, stride, indices, i);
+		xs[i] = p[0];
+		zs[i] = p[2];
+	}
+
+	uint32_t state = 0x9E3779B9u;
+	size_t best = 0;
+
+	for (int k = 0; k < iterations; k++)
+	{
+		size_t i = nextRandom(state) % count;
+		size_t j = nextRandom(state) % count;
+
+		float dx = xs[j] - xs[i], dz = zs[j] - zs[i];
+		float length = std::sqrt(dx * dx + dz * dz);
+		if (!(length > 1e-6f)) { continue; }
+
+		float candidate[3] = { -dz / length, dx / length, 0.0f };
+		candidate[2] = -(candidate[0] * xs[i] + candidate[1] * zs[i]);
+
+		size_t near = countNearLine(xs.data(), zs.data(), count, candidate, threshold);
+		if (near > best)
+		{
+			best = near;
+			line[0] = candidate[0];
+			line[1] = candidate[1];
+			line[2] = candidate[2];
+		}
+	}
+
+	if (best == 0) { return 0; }
+
+	refineLine(xs.data(), zs.data(), count, threshold, line);
+	return countNearLine(xs.data(), zs.data(), count, line, threshold);
+}
+
+//-- Least squares of a x + c z = -(b y + d) over the points within tolerance of the current b and d
+static bool fitSlope(const float* points, size_t stride, const int* indices, size_t count,
+	const float line[3], float tolerance, double& b, double& d)
+{
+	double n = 0.0, sumY = 0.0, sumR = 0.0, sumYY = 0.0, sumYR = 0.0;
+
+	for (size_t i = 0; i < count; i++)
+	{
+		const float* p = record(points, stride, indices, i);
+		double r = double(line[0]) * p[0] + double(line[1]) * p[2];
+
+		if (std::fabs(r + b * p[1] + d) < tolerance)
+		{
+			n += 1.0;
+			sumY += p[1];
+			sumR += r;
+			sumYY += double(p[1]) * p[1];
+			sumYR += p[1] * r;
+		}
+	}
+
+	if (n < 2.0) { return false; }
+
+	double meanY = sumY / n, meanR = sumR / n;
+	double varianceY = sumYY / n - meanY * meanY;
+	double slope = (varianceY > 1e-9) ? (sumYR / n - meanY * meanR) / varianceY : 0.0;
+
+	b = -slope;
+	d = -(meanR - slope * meanY);
+
+	return true;
+}
+
+bool fitTracePlane(const float* points, size_t stride, const int* indices, size_t count,
+	float threshold, float band, int iterations, float plane[4])
+{
+	float line[3];
+	if (fitTraceLine(points, stride, indices, count, threshold, iterations, line) < 2) { return false; }
+
+	//-- On a sloped face the trace moves with height, fit it on the band around the line first,
+	//-- then once more on the points within threshold of that plane
+	double b = 0.0, d = line[2];
+	if (!fitSlope(points, stride, indices, count, line, band, b, d)) { return false; }
+
+	double coarseB = b, coarseD = d;
+	if (!fitSlope(points, stride, indices, count, line, threshold, b, d))
+	{
+		b = coarseB;
+		d = coarseD;
+	}
+
+	double a = line[0], c = line[1];
+	double norm = std::sqrt(a * a + b * b + c * c);
+	Eigen::Vector3d normal(a / norm, b / norm, c / norm);
+	double offset = d / norm;
+
+	//-- The trace direction is biased on sloped faces, a last least squares plane on the inliers takes it out
+	Eigen::Vector3d sum = Eigen::Vector3d::Zero();
+	Eigen::Matrix3d moments = Eigen::Matrix3d::Zero();
+	double n = 0.0;
+
+	for (size_t i = 0; i < count; i++)
+	{
+		const float* p = record(points, stride, indices, i);
+		Eigen::Vector3d point(p[0], p[1], p[2]);
+
+		if (std::fabs(normal.dot(point) + offset) < threshold)
+		{
+			n += 1.0;
+			sum += point;
+			moments += point * point.transpose();
+		}
+	}
+
+	if (n >= 3.0)
+	{
+		Eigen::Vector3d centroid = sum / n;
+		Eigen::Matrix3d covariance = moments / n - centroid * centroid.transpose();
+		Eigen::SelfAdjointEigenSolver<Eigen::Matrix3d> solver(covariance);
+		Eigen::Vector3d refined = solver.eigenvectors().col(0);
+
+		//-- Keep the side of the coarse normal, a degenerate patch keeps the coarse plane
+		if (refined.dot(normal) < 0.0) { refined = -refined; }
+		if (solver.info() == Eigen::Success && refined.dot(normal) > 0.9)
+		{
+			normal = refined;
+			offset = -normal.dot(centroid);
+		}
+	}
+
+	plane[0] = float(normal[0]);
+	plane[1] = float(normal[1]);
+	plane[2] = float(normal[2]);
+	plane[3] = float(offset);
+
+	return true;
+}
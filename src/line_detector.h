@@ -0,0 +1,23 @@
+#define _CRT_SECURE_NO_WARNINGS
+
+#ifndef LINE_DETECTOR_H_
+#define LINE_DETECTOR_H_
+
+#include <cstddef>
+
+//-- Plane fit of the fense and dune faces from their x-z trace, for leveled clouds only
+//-- Records are read like the geometry kernels, x, y, z from the start of records of stride floats,
+//-- indices picks the records if not NULL
+
+//-- RANSAC of the line a x + c z + d = 0 through the x-z trace of the records, refined on its inliers,
+//-- a^2 + c^2 = 1, returns the number of records within threshold of it, 0 if there are fewer than two
+size_t fitTraceLine(const float* points, size_t stride, const int* indices, size_t count,
+	float threshold, int iterations, float line[3]);
+
+//-- Plane a x + b y + c z + d = 0 with unit normal through a vertical or sloped face, the direction comes from
+//-- the trace line, the slope from the height of the records within band of it and a least squares plane on
+//-- the inliers takes out the rest, false if no line was found
+bool fitTracePlane(const float* points, size_t stride, const int* indices, size_t count,
+	float threshold, float band, int iterations, float plane[4]);
+
+#endif
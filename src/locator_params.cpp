@@ -0,0 +1,190 @@
+#include "locator_params.h"
+#include <algorithm>
+
+//-- Farthest depth the stages look at
+#define WORKING_DISTANCE 3.0
+
+//-- Fewest source points along each side of a voxel
+#define POINTS_PER_LEAF 2.0
+
+//-- Smallest neighborhood for the outlier statistics
+#define MIN_SOR_MEAN_K 5
+
+//-- Smallest plane segment
+#define MIN_SEGMENT_SIZE 10
+
+LocatorParams::LocatorParams() :
+voxelLeaf(0.02),
+sorMeanK(10),
+sorStddevMul(0.1),
+mortonOrder(0),
+ransacThreshold(0.01),
+ransacMaxIterations(50),
+groundCosine(0.8),
+groundDistDiff(0.04),
+groundRate(5.0),
+groundSubsample(4),
+horizontalNormalRadius(0.03),
+horizontalCosine(0.90),
+groundBand(0.05),
+horizontalRemoval(0),
+heightCell(0.10),
+flatStddev(0.01),
+tallStddev(0.04),
+verticalSorMeanK(20),
+verticalSorStddevMul(0.05),
+planeNormalRadius(0.04),
+planeCosine(0.80),
+planeDistance(0.10),
+planeDetector(0),
+segmentNeighbours(15),
+segmentSmoothness(8.0),
+segmentCurvature(0.05),
+segmentMinSize(30),
+clusterTolerance(0.1),
+normalThreads(0),
+taskThreads(0),
+frameBudget(0.0),
+speculativeTolerance(0.05),
+depthDecimation(1),
+roiCulling(1),
+roiCullMargin(0.2),
+staticReuse(1),
+staticChange(0.02),
+staticShare(0.01),
+staticMaxFrames(15),
+scaleToResolution(1),
+warmStartInliers(0.8)
+{
+
+}
+
+//-- Name table for tools which set parameters from the command line
+typedef struct
+{
+	const char* name;
+	double LocatorParams::*real;
+	int LocatorParams::*integer;
+
+} ParamEntry;
+
+static const ParamEntry paramTable[] =
+{
+	{ "voxelLeaf",              &LocatorParams::voxelLeaf,              NULL },
+	{ "sorMeanK",               NULL,                                   &LocatorParams::sorMeanK },
+	{ "sorStddevMul",           &LocatorParams::sorStddevMul,           NULL },
+	{ "mortonOrder",            NULL,                                   &LocatorParams::mortonOrder },
+	{ "ransacThreshold",        &LocatorParams::ransacThreshold,        NULL },
+	{ "ransacMaxIterations",    NULL,                                   &LocatorParams::ransacMaxIterations },
+	{ "groundCosine",           &LocatorParams::groundCosine,           NULL },
+	{ "groundDistDiff",         &LocatorParams::groundDistDiff,         NULL },
+	{ "groundRate",             &LocatorParams::groundRate,             NULL },
+	{ "groundSubsample",        NULL,                                   &LocatorParams::groundSubsample },
+	{ "horizontalNormalRadius", &LocatorParams::horizontalNormalRadius, NULL },
+	{ "horizontalCosine",       &LocatorParams::horizontalCosine,       NULL },
+	{ "groundBand",             &LocatorParams::groundBand,             NULL },
+	{ "horizontalRemoval",      NULL,                                   &LocatorParams::horizontalRemoval },
+	{ "heightCell",             &LocatorParams::heightCell,             NULL },
+	{ "flatStddev",             &LocatorParams::flatStddev,             NULL },
+	{ "tallStddev",             &LocatorParams::tallStddev,             NULL },
+	{ "verticalSorMeanK",       NULL,                                   &LocatorParams::verticalSorMeanK },
+	{ "verticalSorStddevMul",   &LocatorParams::verticalSorStddevMul,   NULL },
+	{ "planeNormalRadius",      &LocatorParams::planeNormalRadius,      NULL },
+	{ "planeCosine",            &LocatorParams::planeCosine,            NULL },
+	{ "planeDistance",          &LocatorParams::planeDistance,          NULL },
+	{ "planeDetector",          NULL,                                   &LocatorParams::planeDetector },
+	{ "segmentNeighbours",      NULL,                                   &LocatorParams::segmentNeighbours },
+	{ "segmentSmoothness",      &LocatorParams::segmentSmoothness,      NULL },
+	{ "segmentCurvature",       &LocatorParams::segmentCurvature,       NULL },
+	{ "segmentMinSize",         NULL,                                   &LocatorParams::segmentMinSize },
+	{ "clusterTolerance",       &LocatorParams::clusterTolerance,       NULL },
+	{ "normalThreads",          NULL,                                   &LocatorParams::normalThreads },
+	{ "taskThreads",            NULL,                                   &LocatorParams::taskThreads },
+	{ "frameBudget",            &LocatorParams::frameBudget,            NULL },
+	{ "speculativeTolerance",   &LocatorParams::speculativeTolerance,   NULL },
+	{ "depthDecimation",        NULL,                                   &LocatorParams::depthDecimation },
+	{ "roiCulling",             NULL,                                   &LocatorParams::roiCulling },
+	{ "roiCullMargin",          &LocatorParams::roiCullMargin,          NULL },
+	{ "staticReuse",            NULL,                                   &LocatorParams::staticReuse },
+	{ "staticChange",           &LocatorParams::staticChange,           NULL },
+	{ "staticShare",            &LocatorParams::staticShare,            NULL },
+	{ "staticMaxFrames",        NULL,                                   &LocatorParams::staticMaxFrames },
+	{ "scaleToResolution",      NULL,                                   &LocatorParams::scaleToResolution },
+	{ "warmStartInliers",       &LocatorParams::warmStartInliers,       NULL }
+};
+
+static const ParamEntry* findParam(const std::string& name)
+{
+	for (size_t i = 0; i < sizeof(paramTable) / sizeof(paramTable[0]); i++)
+	{
+		if (name == paramTable[i].name) { return &paramTable[i]; }
+	}
+
+	return NULL;
+}
+
+bool setLocatorParam(LocatorParams& params, const std::string& name, double value)
+{
+	const ParamEntry* entry = findParam(name);
+	if (entry == NULL) { return false; }
+
+	if (entry->real != NULL) { params.*(entry->real) = value; }
+	else { params.*(entry->integer) = int(value + 0.5); }
+
+	return true;
+}
+
+bool getLocatorParam(const LocatorParams& params, const std::string& name, double& value)
+{
+	const ParamEntry* entry = findParam(name);
+	if (entry == NULL) { return false; }
+
+	if (entry->real != NULL) { value = params.*(entry->real); }
+	else { value = params.*(entry->integer); }
+
+	return true;
+}
+
+std::vector<std::string> locatorParamNames(void)
+{
+	std::vector<std::string> names;
+
+	for (size_t i = 0; i < sizeof(paramTable) / sizeof(paramTable[0]); i++)
+	{
+		names.push_back(paramTable[i].name);
+	}
+
+	return names;
+}
+
+//===================================================
+// scaleLocatorParams
+// - The voxel grid hides the resolution as long as
+// each leaf holds a few source points at the far
+// end of the ROIs. Coarser streams grow the leaf and
+// the radii and tolerances measured in leaves with
+// it, the outlier neighborhoods shrink so they
+// still span the same length of a thin fense
+//===================================================
+double scaleLocatorParams(LocatorParams& params, double fx)
+{
+	//-- Pixel footprint at the working distance, 5 mm on the tuned 640x480 color aligned stream
+	double spacing = WORKING_DISTANCE / fx;
+	double scale = std::max(1.0, POINTS_PER_LEAF * spacing / params.voxelLeaf);
+
+	if (scale <= 1.0) { return 1.0; }
+
+	params.voxelLeaf *= scale;
+	params.horizontalNormalRadius *= scale;
+	params.heightCell *= scale;
+	params.planeNormalRadius *= scale;
+	params.clusterTolerance *= scale;
+
+	params.sorMeanK = std::max(MIN_SOR_MEAN_K, int(params.sorMeanK / scale + 0.5));
+	params.verticalSorMeanK = std::max(MIN_SOR_MEAN_K, int(params.verticalSorMeanK / scale + 0.5));
+
+	//-- A patch of the same area holds fewer points
+	params.segmentMinSize = std::max(MIN_SEGMENT_SIZE, int(params.segmentMinSize / (scale * scale) + 0.5));
+
+	return scale;
+}
@@ -0,0 +1,96 @@
+#define _CRT_SECURE_NO_WARNINGS
+
+#ifndef LOCATOR_PARAMS_H_
+#define LOCATOR_PARAMS_H_
+
+#include <string>
+#include <vector>
+
+//-- Tunable parameters of the locating pipeline, defaults are the field-tested values
+struct LocatorParams
+{
+	LocatorParams();
+
+	//-- Down sampling and outlier removal of the source cloud
+	double voxelLeaf;
+	int    sorMeanK;
+	double sorStddevMul;
+	int    mortonOrder;           /* non-zero sorts the down sampled cloud along the Z-order curve */
+
+	//-- Ground plane tracking
+	double ransacThreshold;
+	int    ransacMaxIterations;
+	double groundCosine;
+	double groundDistDiff;
+	double groundRate;            /* background refits per second, 0 refits on every frame */
+	int    groundSubsample;       /* every n-th filtered point goes into a background refit */
+
+	//-- Horizontal plane removal
+	double horizontalNormalRadius;
+	double horizontalCosine;
+	double groundBand;
+	int    horizontalRemoval;     /* HORIZONTAL_REMOVAL_NORMALS or HORIZONTAL_REMOVAL_HEIGHT_BANDS */
+	double heightCell;            /* side of the x-z grid cells of the height bands */
+	double flatStddev;            /* height deviation below which a cell is one horizontal surface */
+	double tallStddev;            /* height deviation above which a cell is a vertical structure */
+	int    verticalSorMeanK;
+	double verticalSorStddevMul;
+
+	//-- Plane extraction within ROI
+	double planeNormalRadius;
+	double planeCosine;
+	double planeDistance;
+
+	//-- Per-frame plane segmentation, used when planeDetector selects the segment map
+	int    planeDetector;
+	int    segmentNeighbours;
+	double segmentSmoothness;     /* degree between neighboring normals */
+	double segmentCurvature;
+	int    segmentMinSize;
+
+	//-- Front fense clustering
+	double clusterTolerance;
+
+	//-- Threads used by the normal estimation, 0 lets OpenMP decide
+	int    normalThreads;
+
+	//-- Threads working on one frame including the calling one, 0 takes every hardware thread
+	int    taskThreads;
+
+	//-- Milliseconds from frame arrival to result, overruns lower the quality level, 0 never does
+	double frameBudget;
+
+	//-- Largest ROI shift a speculative fit on the ROI of the last frame is still used at
+	double speculativeTolerance;
+
+	//-- Depth decimation before deprojection, 0 picks the factor from the resolution
+	int    depthDecimation;
+
+	//-- Non-zero deprojects only the pixels which can land in the ROIs of the stage, grown by roiCullMargin
+	int    roiCulling;
+	double roiCullMargin;
+
+	//-- Non-zero republishes the last result while the scene stands still: fewer than staticShare of the pixels
+	//-- moved further than staticChange, in meters at 1 m, and at most staticMaxFrames frames in a row
+	int    staticReuse;
+	double staticChange;
+	double staticShare;
+	int    staticMaxFrames;
+
+	//-- Non-zero scales the values above from the tuned stream to the one in use on init
+	int    scaleToResolution;
+
+	//-- A saved ground calibration is used if the first frame has this share of the ground inliers it was saved with
+	double warmStartInliers;
+};
+
+bool setLocatorParam(LocatorParams& params, const std::string& name, double value);
+
+bool getLocatorParam(const LocatorParams& params, const std::string& name, double& value);
+
+std::vector<std::string> locatorParamNames(void);
+
+//-- Adapts the point spacing dependent values to a depth stream of focal length fx, returns the length scale
+double scaleLocatorParams(LocatorParams& params, double fx);
+
+#endif
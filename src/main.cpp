@@ -1,58 +1,325 @@
 #include <iostream>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <ctime>
 #include <librealsense2/rs.hpp>
 #include "act_d435.h"
+#include "depth_sequence.h"
+#include "flight_recorder.h"
 #include "robot_locator.h"
+#include "thread_profile.h"
 
 using namespace std;
 
+//-- Frames between two latency reports
+#define LATENCY_REPORT_FRAMES 100
+
+//-- What the locator published for the last frame, as saved by the flight recorder
+template <typename Locator>
+static LocateRecord makeLocateRecord(Locator& locator, const ThreadCounters& frameCounters)
+{
+	const LocateResult& result = locator.getResult();
+	const ObjectROI* rois[3] = { &locator.getLeftFenseROI(), &locator.getDuneROI(), &locator.getFrontFenseROI() };
+	float* fields[3];
+
+	//-- Written out byte for byte, padding included
+	LocateRecord record = LocateRecord();
+	record.timestamp = result.timestamp;
+	record.number = result.number;
+	//-- Stage that measured the values, the vote may have moved status on already
+	record.status = result.status;
+	record.detected = result.detected;
+	record.xDistance = result.xDistance;
+	record.zDistance = result.zDistance;
+	record.duneDistance = result.duneDistance;
+	record.fenseDistance = result.fenseDistance;
+	record.angle = result.angle;
+	record.latency = result.latency;
+	record.quality = result.quality;
+
+	fields[0] = record.leftFenseROI;
+	fields[1] = record.duneROI;
+	fields[2] = record.frontFenseROI;
+
+	for (int i = 0; i < 3; i++)
+	{
+		fields[i][0] = float(rois[i]->xMin);
+		fields[i][1] = float(rois[i]->xMax);
+		fields[i][2] = float(rois[i]->zMin);
+		fields[i][3] = float(rois[i]->zMax);
+	}
+
+	record.contextSwitches = uint32_t(frameCounters.contextSwitches);
+	record.migrations = uint32_t(frameCounters.migrations);
+	record.reused = result.reused ? 1 : 0;
+
+	return record;
+}
+
+static void printUsage(void)
+{
+	cout << "Usage: Test [--profile <name>] [--threads <name>] [--decimation <n>] [--budget <ms>] [--playback <file> | --rig <file>] [--record <file>] [--flight <file>] [--calibration <file>]\n"
+		<< "  --budget is the time from frame arrival to result before quality steps down, 0 never does\n"
+		<< "  --rig takes one camera or sequence per line, see camera_rig.h, --record saves the first one\n"
+		<< "  --calibration keeps the ground plane between starts, ground_calibration.txt by default, \"none\" always calibrates\n"
+		<< "  --flight names the flight recording, flight_<date>_<time>.seq by default, \"none\" turns it off\n"
+		<< "  profiles:";
+
+	vector<string> names = captureProfileNames();
+	for (size_t i = 0; i < names.size(); i++)
+	{
+		const CaptureProfile* profile = findCaptureProfile(names[i]);
+		cout << " " << profile->name << " (" << profile->width << "x" << profile->height << "@" << profile->fps << ")";
+	}
+
+	cout << "\n  thread profiles, see NUC8i7HVK-config.md:";
+
+	names = threadProfileNames();
+	for (size_t i = 0; i < names.size(); i++) { cout << " " << names[i]; }
+
+	cout << endl;
+}
+
 int main(int argc, char* argv[])
 {
+	double programStart = hostClockMs();
+
+	string playbackPath;
+	string recordPath;
+	string rigPath;
+	string flightPath;
+	string calibrationPath = "ground_calibration.txt";
+	string profileName = "default";
+	string threadProfileName = "default";
+	int decimation = -1;
+	double budget = -1.0;
+
+	//-- "--playback <file>" runs on a recorded sequence, "--record <file>" saves every frame
+	for (int i = 1; i + 1 < argc; i++)
+	{
+		if (string(argv[i]) == "--playback") { playbackPath = argv[++i]; }
+		else if (string(argv[i]) == "--record") { recordPath = argv[++i]; }
+		else if (string(argv[i]) == "--rig") { rigPath = argv[++i]; }
+		else if (string(argv[i]) == "--flight") { flightPath = argv[++i]; }
+		else if (string(argv[i]) == "--calibration") { calibrationPath = argv[++i]; }
+		else if (string(argv[i]) == "--profile") { profileName = argv[++i]; }
+		else if (string(argv[i]) == "--threads") { threadProfileName = argv[++i]; }
+		else if (string(argv[i]) == "--decimation") { decimation = atoi(argv[++i]); }
+		else if (string(argv[i]) == "--budget") { budget = atof(argv[++i]); }
+	}
+
+	const CaptureProfile* profile = findCaptureProfile(profileName);
+	const ThreadProfile* threadProfile = findThreadProfile(threadProfileName);
+	if (profile == NULL || threadProfile == NULL)
+	{
+		printUsage();
+		return EXIT_FAILURE;
+	}
+
+	//-- The camera threads librealsense starts from here inherit the capture placement
+	setThreadProfile(*threadProfile);
+	enterThreadRole(THREAD_ROLE_CAPTURE, "capture");
+
 	ActD435			fajD435;
+	PlaybackSource	fajPlayback;
+	FrameSource*	fajSource = &fajD435;
+
+	//-- Sources of the cameras after the first one on a rig
+	vector<unique_ptr<FrameSource> > rigSources;
+	vector<RigEntry> rigEntries;
+	CameraMounts fajMounts;
+
+	if (!rigPath.empty())
+	{
+		if (!loadRig(rigPath, rigEntries))
+		{
+			cerr << "Cannot load rig " << rigPath << endl;
+			return EXIT_FAILURE;
+		}
+
+		for (size_t i = 0; i < rigEntries.size(); i++)
+		{
+			FrameSource* source = NULL;
+
+			if (rigEntries[i].kind == "camera")
+			{
+				ActD435* camera = (i == 0) ? &fajD435 : new ActD435;
+				if (i > 0) { rigSources.push_back(unique_ptr<FrameSource>(camera)); }
+
+				camera->init(*profile, rigEntries[i].target);
+				source = camera;
+			}
+			else
+			{
+				PlaybackSource* playback = (i == 0) ? &fajPlayback : new PlaybackSource;
+				if (i > 0) { rigSources.push_back(unique_ptr<FrameSource>(playback)); }
+
+				if (!playback->open(rigEntries[i].target))
+				{
+					cerr << "Cannot open sequence " << rigEntries[i].target << endl;
+					return EXIT_FAILURE;
+				}
+				source = playback;
+			}
+
+			CameraMount mount = { source, mountTransform(rigEntries[i]) };
+			fajMounts.push_back(mount);
+		}
+
+		fajSource = fajMounts[0].source;
+	}
+	else if (playbackPath.empty())
+	{
+		fajD435.init(*profile);
+	}
+	else
+	{
+		if (!fajPlayback.open(playbackPath))
+		{
+			cerr << "Cannot open sequence " << playbackPath << endl;
+			return EXIT_FAILURE;
+		}
+		fajSource = &fajPlayback;
+	}
+
+	RecordingSource	fajRecorder(*fajSource);
+
+	if (!recordPath.empty())
+	{
+		if (!fajRecorder.open(recordPath))
+		{
+			cerr << "Cannot create sequence " << recordPath << endl;
+			return EXIT_FAILURE;
+		}
+		fajSource = &fajRecorder;
+	}
+
+	//-- Always on unless turned off, every run gets its own file
+	if (flightPath.empty())
+	{
+		char name[64];
+		time_t now = time(NULL);
+		strftime(name, sizeof(name), "flight_%Y%m%d_%H%M%S.seq", localtime(&now));
+		flightPath = name;
+	}
+
+	FlightRecorder	fajFlight(*fajSource);
+
+	if (flightPath != "none")
+	{
+		if (!fajFlight.open(flightPath))
+		{
+			cerr << "Cannot create flight recording " << flightPath << endl;
+			return EXIT_FAILURE;
+		}
+		fajSource = &fajFlight;
+	}
+
+	if (fajMounts.empty())
+	{
+		CameraMount mount = { fajSource, Eigen::Matrix4f::Identity() };
+		fajMounts.push_back(mount);
+	}
+	else
+	{
+		fajMounts[0].source = fajSource;
+	}
+
+	//-- Every source is set up, from here on this is the frame thread
+	enterThreadRole(THREAD_ROLE_LOCATOR, "locator");
+
 	RobotLocator 	fajLocator;
 
-	fajD435.init();
-	fajLocator.init(fajD435);
+	//-- "--decimation <n>" overrides the factor of the profile, 0 picks one from the resolution
+	fajLocator.params.depthDecimation = profile->decimation;
+	if (decimation >= 0) { fajLocator.params.depthDecimation = decimation; }
+
+	//-- One frame interval of the profile unless given
+	fajLocator.params.frameBudget = (budget >= 0.0) ? budget : 1000.0 / profile->fps;
+
+	if (calibrationPath != "none") { fajLocator.setCalibrationPath(calibrationPath); }
+
+	if (threadProfile->taskThreads > 0) { fajLocator.params.taskThreads = threadProfile->taskThreads; }
+	if (threadProfile->ompThreads > 0) { fajLocator.params.normalThreads = threadProfile->ompThreads; }
+
+	if (!fajLocator.init(fajMounts))
+	{
+		cerr << "Cannot initialize the locator" << endl;
+		return EXIT_FAILURE;
+	}
 	fajLocator.status = STARTUP_INITIAL;
 
-	while (!fajLocator.isStoped())
+	vector<double> latencies;
+	vector<int> levelFrames(QualityScheduler::levelNum(), 0);
+	int reusedFrames = 0;
+	double reportStart = hostClockMs();
+	bool startupReported = false;
+
+	//-- Context switches and migrations of the frame thread and the workers, per frame and per report
+	const unsigned int locatorRoles = THREAD_ROLE_BIT(THREAD_ROLE_LOCATOR) | THREAD_ROLE_BIT(THREAD_ROLE_WORKER);
+	ThreadCounters lastCounters = readThreadCounters(locatorRoles);
+	ThreadCounters reportCounters = lastCounters;
+
+	while (!fajLocator.isStoped() && fajLocator.updateCloud())
 	{
-		fajLocator.updateCloud();
-		fajLocator.preProcess();
-		
-		switch (fajLocator.status)
+		fajLocator.locate();
+
+		ThreadCounters counters = readThreadCounters(locatorRoles);
+		ThreadCounters frameCounters = { counters.available, counters.contextSwitches - lastCounters.contextSwitches,
+			counters.migrations - lastCounters.migrations };
+		lastCounters = counters;
+
+		fajFlight.record(makeLocateRecord(fajLocator, frameCounters));
+
+		//-- Time to the first result, what a restart on the field costs
+		if (!startupReported)
 		{
-			case STARTUP_INITIAL:
-				fajLocator.status = BEFORE_GRASSLAND_STAGE_2;
-				break;
+			startupReported = true;
+			printf("First result %.0f ms after start, locator init %.0f ms with %s\n", hostClockMs() - programStart,
+				fajLocator.getStartupTime(), fajLocator.isWarmStarted() ? "saved ground calibration" : "full ground calibration");
+		}
 
-			case BEFORE_DUNE_STAGE_1:
-				fajLocator.locateBeforeDuneStage1();
-				break;
+		//-- End-to-end latency from frame arrival to result
+		latencies.push_back(fajLocator.getResult().latency);
+		levelFrames[fajLocator.getResult().quality]++;
+		if (fajLocator.getResult().reused) { reusedFrames++; }
 
-			case BEFORE_DUNE_STAGE_2:
-				fajLocator.locateBeforeDuneStage2();
-				break;
+		if (latencies.size() == LATENCY_REPORT_FRAMES)
+		{
+			double now = hostClockMs();
+			double mean = 0.0;
+			for (size_t i = 0; i < latencies.size(); i++) { mean += latencies[i]; }
+			mean /= latencies.size();
 
-			case BEFORE_DUNE_STAGE_3:
-				fajLocator.locateBeforeDuneStage3();
-				break;
+			size_t p95 = latencies.size() * 95 / 100;
+			nth_element(latencies.begin(), latencies.begin() + p95, latencies.end());
 
-			case PASSING_DUNE:
-				fajLocator.locatePassingDune();
-				break;
+			printf("%.1f fps, latency mean %.1f ms, p95 %.1f ms, frames per quality level",
+				latencies.size() * 1000.0 / (now - reportStart), mean, latencies[p95]);
 
-			case BEFORE_GRASSLAND_STAGE_1:
-				fajLocator.locateBeforeGrasslandStage1();
-				break;
+			for (size_t i = 0; i < levelFrames.size(); i++) { printf(" %d", levelFrames[i]); }
+			printf(", static frames reused %d", reusedFrames);
+			printf(", flight records dropped %d", int(fajFlight.getDropped()));
 
-			case BEFORE_GRASSLAND_STAGE_2:
-				fajLocator.locateBeforeGrasslandStage2();
-				break;
+			if (lastCounters.available)
+			{
+				printf(", per frame %.1f context switches %.2f migrations",
+					double(lastCounters.contextSwitches - reportCounters.contextSwitches) / latencies.size(),
+					double(lastCounters.migrations - reportCounters.migrations) / latencies.size());
+			}
+			printf("\n");
+			reportCounters = lastCounters;
 
-			default:
-				break;
+			latencies.clear();
+			levelFrames.assign(levelFrames.size(), 0);
+			reusedFrames = 0;
+			reportStart = now;
 		}
 	}
 
 	return EXIT_SUCCESS;
-}
\ No newline at end of file
+}
@@ -0,0 +1,66 @@
+#include "morton_order.h"
+#include <algorithm>
+#include <cmath>
+#include <utility>
+
+#define MORTON_AXIS_BITS 21
+#define MORTON_AXIS_BIAS (1 << (MORTON_AXIS_BITS - 1))
+
+//-- Spreads the low 21 bits two bits apart
+static inline uint64_t spreadBits(uint64_t v)
+{
+	v &= 0x1FFFFFull;
+	v = (v | (v << 32)) & 0x001F00000000FFFFull;
+	v = (v | (v << 16)) & 0x001F0000FF0000FFull;
+	v = (v | (v << 8))  & 0x100F00F00F00F00Full;
+	v = (v | (v << 4))  & 0x10C30C30C30C30C3ull;
+	v = (v | (v << 2))  & 0x1249249249249249ull;
+	return v;
+}
+
+static inline uint64_t cellOf(float value, float cell)
+{
+	float scaled = std::floor(value / cell) + float(MORTON_AXIS_BIAS);
+
+	//-- Also catches NaN
+	if (!(scaled >= 0.0f)) { return (1u << MORTON_AXIS_BITS) - 1; }
+	if (scaled >= float((1u << MORTON_AXIS_BITS) - 1)) { return (1u << MORTON_AXIS_BITS) - 1; }
+
+	return uint64_t(scaled);
+}
+
+uint64_t mortonCode(const float* point, float cell)
+{
+	return spreadBits(cellOf(point[0], cell)) | (spreadBits(cellOf(point[1], cell)) << 1) |
+		(spreadBits(cellOf(point[2], cell)) << 2);
+}
+
+void mortonOrder(const float* points, size_t stride, size_t count, float cell, std::vector<int>& order)
+{
+	std::vector<std::pair<uint64_t, int> > keys(count);
+	for (size_t i = 0; i < count; i++) { keys[i] = std::make_pair(mortonCode(points + i * stride, cell), int(i)); }
+
+	//-- The index breaks ties, so equal codes keep their order
+	std::sort(keys.begin(), keys.end());
+
+	order.resize(count);
+	for (size_t i = 0; i < count; i++) { order[i] = keys[i].second; }
+}
+
+void mortonSpans(const float* points, size_t stride, size_t count, float cell, MortonSpans& spans)
+{
+	spans.clear();
+
+	for (size_t i = 0; i < count; i++)
+	{
+		uint64_t block = mortonCode(points + i * stride, cell) >> (3 * MORTON_BLOCK_BITS);
+
+		if (spans.empty() || spans.back().block != block)
+		{
+			MortonSpan span = { int(i), int(i), block };
+			spans.push_back(span);
+		}
+
+		spans.back().end = int(i) + 1;
+	}
+}
@@ -0,0 +1,36 @@
+#define _CRT_SECURE_NO_WARNINGS
+
+#ifndef MORTON_ORDER_H_
+#define MORTON_ORDER_H_
+
+#include <cstddef>
+#include <stdint.h>
+#include <vector>
+
+//-- Blocks of the span list, 2^MORTON_BLOCK_BITS cells per side
+#define MORTON_BLOCK_BITS 3
+
+//-- Z-order of point records on a grid of cubic cells, points close in space end up close in memory
+//-- Records are read like the geometry kernels, x, y, z from the start of records of stride floats
+//-- Cells are counted from the camera origin with 21 bits per axis, far or NaN points go to the last cell
+
+//-- Run of a Morton ordered cloud inside one block, [begin, end)
+typedef struct
+{
+	int      begin;
+	int      end;
+	uint64_t block;   /* Morton code of the block */
+
+} MortonSpan;
+
+typedef std::vector<MortonSpan> MortonSpans;
+
+uint64_t mortonCode(const float* point, float cell);
+
+//-- Permutation that sorts the records along the curve, equal codes keep their order
+void mortonOrder(const float* points, size_t stride, size_t count, float cell, std::vector<int>& order);
+
+//-- Runs of the records of an ordered cloud sharing one block, in cloud order
+void mortonSpans(const float* points, size_t stride, size_t count, float cell, MortonSpans& spans);
+
+#endif
@@ -0,0 +1,121 @@
+#define _CRT_SECURE_NO_WARNINGS
+
+#ifndef PARALLEL_FILTER_H_
+#define PARALLEL_FILTER_H_
+
+#include <algorithm>
+#include <vector>
+#include <stdint.h>
+#include <pcl/point_types.h>
+#include <pcl/point_cloud.h>
+#include "task_pool.h"
+
+//-- Points per task, smaller inputs are filtered on the calling thread
+#define PARALLEL_FILTER_CHUNK      4096
+
+//-- Order preserving stream compaction on the task pool
+//-- Every chunk stores one flag per element and its count, a prefix sum over the counts gives each chunk its output offset,
+//-- then the chunks write their selected elements in parallel
+
+//-- Positions i < count flagged by mask(begin, end, flags), which sets flags[i] to 0 or 1 for begin <= i < end,
+//-- or map[i] for them if map is given, the mask sees chunks of up to PARALLEL_FILTER_CHUNK so it can run SIMD kernels
+template <typename Mask>
+void parallelSelectMasked(TaskPool& pool, size_t count, const Mask& mask, std::vector<int>& selected,
+	const int* map = NULL)
+{
+	size_t chunkNum = (count + PARALLEL_FILTER_CHUNK - 1) / PARALLEL_FILTER_CHUNK;
+	std::vector<uint8_t> flags(count);
+
+	if (chunkNum <= 1 || pool.size() == 1)
+	{
+		for (size_t begin = 0; begin < count; begin += PARALLEL_FILTER_CHUNK)
+		{
+			mask(begin, std::min(count, begin + PARALLEL_FILTER_CHUNK), flags.data());
+		}
+
+		selected.clear();
+		for (size_t i = 0; i < count; i++)
+		{
+			if (flags[i]) { selected.push_back(map ? map[i] : int(i)); }
+		}
+		return;
+	}
+
+	std::vector<size_t> offsets(chunkNum + 1, 0);
+
+	{
+		TaskGroup group(pool);
+		for (size_t c = 0; c < chunkNum; c++)
+		{
+			group.run([&, c]()
+			{
+				size_t begin = c * PARALLEL_FILTER_CHUNK;
+				size_t end = std::min(count, begin + PARALLEL_FILTER_CHUNK);
+				size_t kept = 0;
+
+				mask(begin, end, flags.data());
+				for (size_t i = begin; i < end; i++) { kept += flags[i]; }
+
+				offsets[c + 1] = kept;
+			});
+		}
+	}
+
+	for (size_t c = 0; c < chunkNum; c++) { offsets[c + 1] += offsets[c]; }
+	selected.resize(offsets[chunkNum]);
+
+	TaskGroup group(pool);
+	for (size_t c = 0; c < chunkNum; c++)
+	{
+		group.run([&, c]()
+		{
+			size_t begin = c * PARALLEL_FILTER_CHUNK;
+			size_t end = std::min(count, begin + PARALLEL_FILTER_CHUNK);
+			int* out = selected.data() + offsets[c];
+
+			for (size_t i = begin; i < end; i++)
+			{
+				if (flags[i]) { *out++ = map ? map[i] : int(i); }
+			}
+		});
+	}
+}
+
+//-- Positions i < count for which keep(i) holds, or map[i] for them if map is given
+template <typename Predicate>
+void parallelSelect(TaskPool& pool, size_t count, const Predicate& keep, std::vector<int>& selected,
+	const int* map = NULL)
+{
+	parallelSelectMasked(pool, count, [&](size_t begin, size_t end, uint8_t* flags)
+	{
+		//-- No branch on the outcome, the compiler may vectorize inlined predicates
+		for (size_t i = begin; i < end; i++) { flags[i] = keep(i) ? 1 : 0; }
+	}, selected, map);
+}
+
+//-- Copy of the indexed points in index order, replaces the content of dst, which must not be src
+template <typename PointT>
+void parallelGather(TaskPool& pool, const pcl::PointCloud<PointT>& src, const std::vector<int>& indices,
+	pcl::PointCloud<PointT>& dst)
+{
+	dst.points.resize(indices.size());
+	dst.width = uint32_t(indices.size());
+	dst.height = 1;
+	dst.is_dense = src.is_dense;
+	dst.header = src.header;
+	dst.sensor_origin_ = src.sensor_origin_;
+	dst.sensor_orientation_ = src.sensor_orientation_;
+
+	TaskGroup group(pool);
+	for (size_t begin = 0; begin < indices.size(); begin += PARALLEL_FILTER_CHUNK)
+	{
+		size_t end = std::min(indices.size(), begin + PARALLEL_FILTER_CHUNK);
+
+		group.run([&, begin, end]()
+		{
+			for (size_t i = begin; i < end; i++) { dst.points[i] = src.points[indices[i]]; }
+		});
+	}
+}
+
+#endif
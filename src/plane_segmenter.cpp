@@ -0,0 +1,53 @@
+#include "plane_segmenter.h"
+#include <pcl/common/common.h>
+#include <pcl/features/normal_3d.h>
+#include <pcl/search/kdtree.h>
+#include <pcl/segmentation/region_growing.h>
+
+//===================================================
+// segmentPlanes
+// - Neighbors join a patch while their normals stay
+// within the smoothness angle, patches below the
+// minimum size are dropped, the rest are fitted by
+// least squares over all of their points
+//===================================================
+template <typename PointT>
+void segmentPlanes(typename pcl::PointCloud<PointT>::Ptr cloud, pcl::PointCloud<pcl::Normal>::Ptr normals,
+	const LocatorParams& params, PlaneSegments& segments)
+{
+	segments.clear();
+	if (cloud->points.empty()) { return; }
+
+	typename pcl::search::KdTree<PointT>::Ptr tree(new pcl::search::KdTree<PointT>);
+
+	pcl::RegionGrowing<PointT, pcl::Normal> grow;
+	grow.setMinClusterSize(params.segmentMinSize);
+	grow.setMaxClusterSize(int(cloud->points.size()));
+	grow.setNumberOfNeighbours(params.segmentNeighbours);
+	grow.setSmoothnessThreshold(float(params.segmentSmoothness / 180.0 * 3.1415926));
+	grow.setCurvatureThreshold(float(params.segmentCurvature));
+	grow.setSearchMethod(tree);
+	grow.setInputCloud(cloud);
+	grow.setInputNormals(normals);
+
+	std::vector<pcl::PointIndices> clusters;
+	grow.extract(clusters);
+
+	for (size_t i = 0; i < clusters.size(); i++)
+	{
+		PlaneSegment segment;
+		segment.inliers.reset(new pcl::PointIndices(clusters[i]));
+
+		if (!pcl::computePointNormal(*cloud, segment.inliers->indices, segment.coefficients, segment.curvature)) { continue; }
+
+		pcl::compute3DCentroid(*cloud, segment.inliers->indices, segment.centroid);
+		pcl::getMinMax3D(*cloud, segment.inliers->indices, segment.minPoint, segment.maxPoint);
+
+		segments.push_back(segment);
+	}
+}
+
+template void segmentPlanes<pcl::PointXYZ>(pcl::PointCloud<pcl::PointXYZ>::Ptr cloud,
+	pcl::PointCloud<pcl::Normal>::Ptr normals, const LocatorParams& params, PlaneSegments& segments);
+template void segmentPlanes<pcl::PointXYZRGB>(pcl::PointCloud<pcl::PointXYZRGB>::Ptr cloud,
+	pcl::PointCloud<pcl::Normal>::Ptr normals, const LocatorParams& params, PlaneSegments& segments);
@@ -0,0 +1,39 @@
+#define _CRT_SECURE_NO_WARNINGS
+
+#ifndef PLANE_SEGMENTER_H_
+#define PLANE_SEGMENTER_H_
+
+#include <vector>
+#include <Eigen/Dense>
+#include <pcl/point_types.h>
+#include <pcl/PointIndices.h>
+#include "frame_source.h"
+#include "locator_params.h"
+
+//-- How the locate stages find planes within their ROI
+#define PLANE_DETECTOR_RANSAC        0   /* RANSAC on the raw points of every ROI */
+#define PLANE_DETECTOR_SEGMENT_MAP   1   /* pick from the planes segmented once per frame */
+#define PLANE_DETECTOR_TRACE_LINE    2   /* line RANSAC on the x-z trace of every ROI, no normals */
+
+//-- Planar patch of the vertical cloud
+typedef struct
+{
+	Eigen::Vector4f coefficients;   /* ax + by + cz + d = 0 with unit normal */
+	Eigen::Vector4f centroid;
+	Eigen::Vector4f minPoint;       /* bounding box */
+	Eigen::Vector4f maxPoint;
+	float           curvature;      /* surface variation of the fit, 0 for a perfect plane */
+
+	pcl::PointIndices::Ptr inliers;
+
+} PlaneSegment;
+
+typedef std::vector<PlaneSegment, Eigen::aligned_allocator<PlaneSegment> > PlaneSegments;
+
+//-- Splits the cloud into smooth patches by region growing on the normals and fits a plane to each
+//-- Instantiated for pcl::PointXYZ and pcl::PointXYZRGB
+template <typename PointT>
+void segmentPlanes(typename pcl::PointCloud<PointT>::Ptr cloud, pcl::PointCloud<pcl::Normal>::Ptr normals,
+	const LocatorParams& params, PlaneSegments& segments);
+
+#endif
@@ -0,0 +1,100 @@
+#include "quality_scheduler.h"
+#include "frame_source.h"
+#include <algorithm>
+
+//-- Share of the budget below which a frame counts as headroom
+#define HEADROOM_RATIO   0.7
+
+//-- Frames with headroom in a row before stepping back up
+#define RECOVER_FRAMES   15
+
+static const QualityLevel qualityLevels[] =
+{
+	{ 1.00, 1.0, 1.00, true  },
+	{ 1.00, 0.5, 1.00, false },
+	{ 1.25, 0.5, 0.75, false },
+	{ 1.50, 0.3, 0.50, false }
+};
+
+QualityScheduler::QualityScheduler() :
+budget(0.0),
+deadline(0.0),
+level(0),
+headroomFrames(0)
+{
+
+}
+
+void QualityScheduler::setBudget(double budget)
+{
+	this->budget = budget;
+	level = 0;
+	headroomFrames = 0;
+}
+
+int QualityScheduler::levelNum(void)
+{
+	return int(sizeof(qualityLevels) / sizeof(qualityLevels[0]));
+}
+
+void QualityScheduler::apply(const LocatorParams& base, LocatorParams& params) const
+{
+	const QualityLevel& quality = qualityLevels[level];
+
+	params = base;
+
+	params.voxelLeaf *= quality.voxelScale;
+	params.horizontalNormalRadius *= quality.voxelScale;
+	params.heightCell *= quality.voxelScale;
+	params.planeNormalRadius *= quality.voxelScale;
+	params.clusterTolerance *= quality.voxelScale;
+
+	params.ransacMaxIterations = std::max(1, int(base.ransacMaxIterations * quality.iterationScale + 0.5));
+
+	params.sorMeanK = std::max(1, int(base.sorMeanK * quality.sorScale + 0.5));
+	params.verticalSorMeanK = std::max(1, int(base.verticalSorMeanK * quality.sorScale + 0.5));
+}
+
+void QualityScheduler::beginFrame(double arrival)
+{
+	deadline = arrival + budget;
+}
+
+//===================================================
+// endFrame
+// - One overrun steps down right away, stepping up
+// waits for a run of frames well within budget so
+// the level does not flip on every other frame
+//===================================================
+void QualityScheduler::endFrame(double latency)
+{
+	if (!isActive()) { return; }
+
+	if (latency > budget)
+	{
+		level = std::min(level + 1, levelNum() - 1);
+		headroomFrames = 0;
+	}
+	else if (latency < budget * HEADROOM_RATIO && level > 0)
+	{
+		if (++headroomFrames >= RECOVER_FRAMES)
+		{
+			level--;
+			headroomFrames = 0;
+		}
+	}
+	else
+	{
+		headroomFrames = 0;
+	}
+}
+
+bool QualityScheduler::isOverBudget(void) const
+{
+	return isActive() && hostClockMs() > deadline;
+}
+
+bool QualityScheduler::isViewerEnabled(void) const
+{
+	return qualityLevels[level].viewer && !isOverBudget();
+}
@@ -0,0 +1,50 @@
+#define _CRT_SECURE_NO_WARNINGS
+
+#ifndef QUALITY_SCHEDULER_H_
+#define QUALITY_SCHEDULER_H_
+
+#include "locator_params.h"
+
+//-- Degradation applied to the parameters at one quality level, level 0 is the full pipeline
+typedef struct
+{
+	double voxelScale;       /* voxel leaf and the radii measured in leaves */
+	double iterationScale;   /* RANSAC iterations */
+	double sorScale;         /* outlier neighborhoods */
+	bool   viewer;
+
+} QualityLevel;
+
+//-- Steps quality down when a frame overruns its budget and back up after a run of frames with headroom
+class QualityScheduler
+{
+public:
+	QualityScheduler();
+
+	//-- Budget in milliseconds from frame arrival to result, 0 turns scheduling off
+	void setBudget(double budget);
+	inline bool isActive(void) const { return budget > 0.0; }
+
+	//-- Parameters of the current level derived from the full quality ones
+	void apply(const LocatorParams& base, LocatorParams& params) const;
+
+	void beginFrame(double arrival);
+	void endFrame(double latency);
+
+	//-- Whether the running frame is past its deadline
+	bool isOverBudget(void) const;
+
+	inline int getLevel(void) const { return level; }
+	bool isViewerEnabled(void) const;
+
+	static int levelNum(void);
+
+private:
+	double budget;
+	double deadline;
+
+	int    level;
+	int    headroomFrames;
+};
+
+#endif
@@ -1,185 +1,767 @@
 #include "robot_locator.h"
+#include "geometry_kernels.h"
+#include "line_detector.h"
+#include <algorithm>
 
-RobotLocator::RobotLocator() : srcCloud(new pointCloud),
-filteredCloud(new pointCloud),
-verticalCloud(new pointCloud),
-dstCloud(new pointCloud),
+//-- Records of a PCL cloud as the geometry kernels read them
+template <typename T>
+static inline const float* floatsOf(const pcl::PointCloud<T>& cloud)
+{
+	return reinterpret_cast<const float*>(cloud.points.data());
+}
+
+template <typename T>
+static inline size_t strideOf(const pcl::PointCloud<T>&)
+{
+	return sizeof(T) / sizeof(float);
+}
+
+//-- Pixel step of the full frame sample the ground is fitted on while the frame is culled to the ROIs
+#define GROUND_SAMPLE_STEP 4
+
+//-- A locate stage and the per-frame features it depends on
+template <typename Locator>
+struct LocatorStage
+{
+	unsigned int status;
+	unsigned int features;
+	unsigned int rois;
+	void (Locator::*locate)(void);
+};
+
+template <typename PointT, template <typename> class DebugPolicy>
+RobotLocatorT<PointT, DebugPolicy>::RobotLocatorT(bool interactive) : interactive(interactive),
+srcCloud(new Cloud),
+groundSample(new Cloud),
+groundSampled(false),
+filteredCloud(new Cloud),
+verticalCloud(new Cloud),
+horizontalNormals(new pcl::PointCloud<pcl::Normal>),
+verticalNormals(new pcl::PointCloud<pcl::Normal>),
+readyFeatures(FEATURE_NONE),
+staticFrame(false),
+reusedFrames(0),
+located(false),
+lastVote(-1),
+warmStarted(false),
+startupTime(0.0),
+groundInlierShare(0.0),
 indicesROI(new pcl::PointIndices),
 groundCoeff(new pcl::ModelCoefficients),
 groundCoeffRotated(new pcl::ModelCoefficients),
-dstViewer(new pcl::visualization::PCLVisualizer("Advanced Viewer"))
+debugView(interactive)
 {
+	status = STARTUP_INITIAL;
+	nextStatusCounter = 0;
+
 	leftFenseROI = { -0.3/*xMin*/, -0.2/*xMax*/, 0.0/*zMin*/, 2.5/*zMax*/ };
 	duneROI = { -0.3/*xMin*/,  0.3/*xMax*/, 0.0/*zMin*/, 2.5/*zMax*/ };
 	// frontFenseROI = { -1.3/*xMin*/,  0.3/*xMax*/, 1.2/*zMin*/, 2.1/*zMax*/ };
 	frontFenseROI = { -0.3/*xMin*/,  0.3/*xMax*/, 0.0/*zMin*/, 1.5/*zMax*/ };
-
-	dstViewer->setBackgroundColor(0.259, 0.522, 0.957);
-	dstViewer->addPointCloud<pointType>(dstCloud, "Destination Cloud");
-	dstViewer->addCoordinateSystem(0.2, "view point");
-	dstViewer->initCameraParameters();
 }
 
-RobotLocator::~RobotLocator()
+template <typename PointT, template <typename> class DebugPolicy>
+RobotLocatorT<PointT, DebugPolicy>::~RobotLocatorT()
 {
+	groundEstimator.stop();
+}
 
+template <typename PointT, template <typename> class DebugPolicy>
+bool RobotLocatorT<PointT, DebugPolicy>::init(FrameSource& source)
+{
+	CameraMount mount = { &source, Eigen::Matrix4f::Identity() };
+	return init(CameraMounts(1, mount));
 }
 
-void RobotLocator::init(ActD435& d435)
+template <typename PointT, template <typename> class DebugPolicy>
+bool RobotLocatorT<PointT, DebugPolicy>::init(const CameraMounts& mounts)
 {
-	cout << "Initializing locator..." << endl;
+	double initStart = hostClockMs();
+
+	if (interactive) { cout << "Initializing locator..." << endl; }
+
+	taskPool.reset(new TaskPool(params.taskThreads, "locator"));
 
-	//-- Set input device
-	thisD435 = &d435;
+	//-- Set input devices, the first camera deprojects straight into srcCloud
+	cameras = mounts;
+	depthFrames.resize(cameras.size());
+	staticDepth.resize(cameras.size());
+	depthChange.resize(cameras.size(), 1.0);
+	cameraClouds.resize(cameras.size());
+	cameraFiltered.resize(cameras.size());
+
+	for (size_t i = 0; i < cameras.size(); i++)
+	{
+		cameraClouds[i] = (i == 0) ? srcCloud : CloudPtr(new Cloud);
+		cameraFiltered[i].reset(new Cloud);
+	}
+
+	//-- A calibration saved by an earlier start spares the settling frames and the ground fits if it still holds
+	GroundCalibration calibration;
+	bool hasCalibration = !calibrationPath.empty() && loadGroundCalibration(calibrationPath, calibration);
 
 	//-- Drop several frames for stable point cloud
-	for (int i = 0; i < 3; i++)
+	for (int i = 0; i < (hasCalibration ? 1 : 3); i++)
 	{
-		thisD435->update();
+		if (!grabCloud())
+		{
+			if (interactive) { cout << "No depth frame to initialize from" << endl; }
+			return false;
+		}
 	}
 
-	//-- Initialize ground coefficients
-	cout << "Initializing ground coefficients..." << endl;
+	//-- Fit the point spacing dependent parameters to the stream
+	if (params.scaleToResolution)
+	{
+		//-- The coarsest camera decides
+		double fx = depthFrames[0].intrinsics.fx;
+		for (size_t i = 1; i < depthFrames.size(); i++) { fx = min(fx, double(depthFrames[i].intrinsics.fx)); }
 
-	groundCoeff->values.clear();
-	groundCoeff->values.push_back(0.0f);
-	groundCoeff->values.push_back(0.0f);
-	groundCoeff->values.push_back(0.0f);
-	groundCoeff->values.push_back(0.0f);
+		double scale = scaleLocatorParams(params, fx);
 
-	groundCoeffRotated->values.clear();
-	groundCoeffRotated->values.push_back(0.0f);
-	groundCoeffRotated->values.push_back(0.0f);
-	groundCoeffRotated->values.push_back(0.0f);
-	groundCoeffRotated->values.push_back(0.0f);
+		if (interactive)
+		{
+			cout << "Depth stream " << depthFrames[0].intrinsics.width << "x" << depthFrames[0].intrinsics.height
+				<< ", parameter scale " << scale << endl;
+		}
+	}
 
-	const int cycleNum = 10;
-	for (int i = 0; i < cycleNum; i++)
+	groundCoeff->values.assign(4, 0.0f);
+	groundCoeffRotated->values.assign(4, 0.0f);
+
+	warmStarted = hasCalibration && checkGroundCalibration(calibration);
+
+	if (warmStarted)
+	{
+		groundCoeff->values.assign(calibration.ground, calibration.ground + 4);
+		if (interactive) { cout << "Ground coefficients restored from " << calibrationPath << endl; }
+	}
+	else
+	{
+		//-- Initialize ground coefficients
+		if (interactive) { cout << "Initializing ground coefficients..." << endl; }
+
+		if (!calibrateGround())
+		{
+			if (interactive) { cout << "No ground found while initializing" << endl; }
+			return false;
+		}
+
+		if (!calibrationPath.empty())
+		{
+			saveGroundCalibration(calibrationPath, currentCalibration());
+		}
+	}
+
+	if (interactive)
 	{
-		srcCloud = thisD435->update();
+		cout << "Ground coefficients: " << groundCoeff->values[0] << " "
+			<< groundCoeff->values[1] << " "
+			<< groundCoeff->values[2] << " "
+			<< groundCoeff->values[3] << endl;
+	}
+
+	//-- From here on the ground only follows slow tilts, the background estimator refits it
+	makeGroundSnapshot(groundCoeff->values.data(), depthFrames[0].number, ground);
 
-		pcl::PassThrough<pointType> pass;
-		pass.setInputCloud(srcCloud);
-		pass.setFilterFieldName("z");
-		pass.setFilterLimits(0.0f, 3.0f);
-		pass.filter(*srcCloud);
+	groundEstimator.stop();
+	if (params.groundRate > 0.0) { groundEstimator.start(params, ground); }
 
-		pcl::VoxelGrid<pointType> passVG;
-		passVG.setInputCloud(srcCloud);
-		passVG.setLeafSize(0.02f, 0.02f, 0.02f);
-		passVG.filter(*srcCloud);
+	baseParams = params;
+	scheduler.setBudget(params.frameBudget);
+
+	startupTime = hostClockMs() - initStart;
+
+	if (interactive) { cout << "Done initialization in " << startupTime << " ms." << endl; }
+
+	return true;
+}
+
+//===================================================
+// calibrateGround
+// - Averages the ground fits of several frames,
+// the first camera alone defines the ground, frames
+// without a fit are left out
+//===================================================
+template <typename PointT, template <typename> class DebugPolicy>
+bool RobotLocatorT<PointT, DebugPolicy>::calibrateGround(void)
+{
+	const int cycleNum = 10;
+	int fitNum = 0;
+
+	for (int i = 0; i < cycleNum; i++)
+	{
+		//-- A short sequence ends here, average what it gave
+		if (!grabCloud()) { break; }
+		groundCandidates(srcCloud);
 
 		pcl::ModelCoefficients::Ptr coefficients(new pcl::ModelCoefficients);
 		pcl::PointIndices::Ptr inliers(new pcl::PointIndices);
 
-		pcl::SACSegmentation<pointType> seg;
+		pcl::SACSegmentation<PointT> seg;
 		seg.setOptimizeCoefficients(true);
 		seg.setModelType(pcl::SACMODEL_PLANE);
 		seg.setMethodType(pcl::SAC_RANSAC);
-		seg.setDistanceThreshold(0.01);
+		seg.setDistanceThreshold(params.ransacThreshold);
+		seg.setMaxIterations(params.ransacMaxIterations);
 
 		seg.setInputCloud(srcCloud);
 		seg.segment(*inliers, *coefficients);
 
+		if (coefficients->values.size() != 4) { continue; }
+		fitNum++;
+
 		groundCoeff->values[0] += coefficients->values[0];
 		groundCoeff->values[1] += coefficients->values[1];
 		groundCoeff->values[2] += coefficients->values[2];
 		groundCoeff->values[3] += coefficients->values[3];
 
-		cout << "Model coefficients: " << coefficients->values[0] << " "
-			<< coefficients->values[1] << " "
-			<< coefficients->values[2] << " "
-			<< coefficients->values[3] << endl;
+		if (interactive)
+		{
+			cout << "Model coefficients: " << coefficients->values[0] << " "
+				<< coefficients->values[1] << " "
+				<< coefficients->values[2] << " "
+				<< coefficients->values[3] << endl;
+		}
 	}
 
-	groundCoeff->values[0] /= cycleNum;
-	groundCoeff->values[1] /= cycleNum;
-	groundCoeff->values[2] /= cycleNum;
-	groundCoeff->values[3] /= cycleNum;
+	if (fitNum == 0) { return false; }
+
+	groundCoeff->values[0] /= fitNum;
+	groundCoeff->values[1] /= fitNum;
+	groundCoeff->values[2] /= fitNum;
+	groundCoeff->values[3] /= fitNum;
 
-	cout << "Ground coefficients: " << groundCoeff->values[0] << " "
-		<< groundCoeff->values[1] << " "
-		<< groundCoeff->values[2] << " "
-		<< groundCoeff->values[3] << endl;
+	//-- Reference for the checks of later starts, on the last frame
+	groundInlierShare = groundShare(srcCloud, groundCoeff->values.data());
 
-	cout << "Done initialization." << endl;
+	return true;
 }
 
-pPointCloud RobotLocator::updateCloud(void)
+template <typename PointT, template <typename> class DebugPolicy>
+void RobotLocatorT<PointT, DebugPolicy>::groundCandidates(CloudPtr cloud)
 {
-	//-- copy the pointer to srcCloud
-	srcCloud = thisD435->update();
-	return srcCloud;
+	pcl::PassThrough<PointT> pass;
+	pass.setInputCloud(cloud);
+	pass.setFilterFieldName("z");
+	pass.setFilterLimits(0.0f, 3.0f);
+	pass.filter(*cloud);
+
+	pcl::VoxelGrid<PointT> passVG;
+	passVG.setInputCloud(cloud);
+	passVG.setLeafSize(params.voxelLeaf, params.voxelLeaf, params.voxelLeaf);
+	passVG.filter(*cloud);
 }
 
-void RobotLocator::preProcess(void)
+template <typename PointT, template <typename> class DebugPolicy>
+double RobotLocatorT<PointT, DebugPolicy>::groundShare(CloudPtr cloud, const float* plane)
 {
+	if (cloud->points.empty()) { return 0.0; }
 
+	float unitPlane[4];
+	normalizePlane(plane, unitPlane);
+	if (unitPlane[0] == 0.0f && unitPlane[1] == 0.0f && unitPlane[2] == 0.0f) { return 0.0; }
 
+	const float threshold = float(params.ransacThreshold);
+	const float* points = floatsOf(*cloud);
+	const size_t stride = strideOf(*cloud);
 
-	//-- Pass through filter
+	vector<int> inliers;
+	parallelSelectMasked(*taskPool, cloud->points.size(), [&](size_t begin, size_t end, uint8_t* flags)
+	{
+		distanceMask(points + begin * stride, stride, NULL, end - begin, unitPlane, threshold, false, flags + begin);
+	}, inliers);
 
-	pcl::PassThrough<pointType> pass;
+	return double(inliers.size()) / cloud->points.size();
+}
 
-	pass.setInputCloud(srcCloud);
-	pass.setFilterFieldName("x");
-	pass.setFilterLimits(-1.0f, 1.0f);
-	pass.filter(*filteredCloud);
+//===================================================
+// checkGroundCalibration
+// - A saved ground is trusted if the stream and the
+// rig are unchanged and the current frame still has
+// most of the ground inliers it was saved with
+//===================================================
+template <typename PointT, template <typename> class DebugPolicy>
+bool RobotLocatorT<PointT, DebugPolicy>::checkGroundCalibration(const GroundCalibration& calibration)
+{
+	if (calibration.width != depthFrames[0].intrinsics.width || calibration.height != depthFrames[0].intrinsics.height ||
+		calibration.extrinsics.size() != cameras.size())
+	{
+		return false;
+	}
 
-	pass.setInputCloud(filteredCloud);
-	pass.setFilterFieldName("z");
-	pass.setFilterLimits(0.0f, 4.0f);
-	pass.filter(*filteredCloud);
+	for (size_t i = 0; i < cameras.size(); i++)
+	{
+		if (!calibration.extrinsics[i].isApprox(cameras[i].extrinsics, 1e-4f)) { return false; }
+	}
 
+	groundCandidates(srcCloud);
 
+	double share = groundShare(srcCloud, calibration.ground);
 
-	//-- Down sampling
+	if (interactive)
+	{
+		cout << "Saved ground plane holds " << share * 100.0 << "% of the points, "
+			<< calibration.inlierShare * 100.0 << "% when saved" << endl;
+	}
 
-	pcl::VoxelGrid<pointType> passVG;
-	passVG.setInputCloud(filteredCloud);
-	passVG.setLeafSize(0.02f, 0.02f, 0.02f);
-	passVG.filter(*filteredCloud);
+	return share > 0.0 && share >= params.warmStartInliers * calibration.inlierShare;
+}
 
+template <typename PointT, template <typename> class DebugPolicy>
+GroundCalibration RobotLocatorT<PointT, DebugPolicy>::currentCalibration(void)
+{
+	GroundCalibration calibration;
+	calibration.width = depthFrames[0].intrinsics.width;
+	calibration.height = depthFrames[0].intrinsics.height;
+	calibration.inlierShare = float(groundInlierShare);
 
+	for (int i = 0; i < 4; i++) { calibration.ground[i] = groundCoeff->values[i]; }
+	for (size_t i = 0; i < cameras.size(); i++) { calibration.extrinsics.push_back(cameras[i].extrinsics); }
 
-	//-- Remove outliers
-	//start = chrono::steady_clock::now();
-	pcl::StatisticalOutlierRemoval<pointType> passSOR;
-	passSOR.setInputCloud(filteredCloud);
-	passSOR.setMeanK(10);
-	passSOR.setStddevMulThresh(0.1);
-	passSOR.filter(*filteredCloud);
+	return calibration;
+}
+
+template <typename PointT, template <typename> class DebugPolicy>
+bool RobotLocatorT<PointT, DebugPolicy>::updateCloud(void)
+{
+	//-- With several cameras each one is preprocessed on its own thread and the results are fused
+	bool fuse = cameras.size() > 1;
+
+	if (!grabCloud(fuse)) { return false; }
+
+	//-- Every feature of the last frame is outdated now, unless the scene stood still
+	if (!staticFrame) { readyFeatures = FEATURE_NONE; }
+
+	//-- Quality level for this frame
+	if (scheduler.isActive())
+	{
+		scheduler.beginFrame(frameArrival());
+		scheduler.apply(baseParams, params);
+	}
+
+	if (fuse && !staticFrame)
+	{
+		filteredCloud->clear();
+		for (size_t i = 0; i < cameraFiltered.size(); i++) { *filteredCloud += *cameraFiltered[i]; }
+
+		//-- Each camera is ordered on its own, the fields of view overlap
+		if (params.mortonOrder && cameraFiltered.size() > 1) { mortonSort(filteredCloud); }
+
+		readyFeatures |= FEATURE_FILTERED_CLOUD;
+	}
+
+	return true;
+}
+
+//===================================================
+// grabCloud
+// - Captures all cameras at once, the calling
+// thread takes the first one and the task pool the
+// others, so a frame costs the slowest camera
+// - Frames of a scene that stood still are not
+// deprojected, the clouds of the last processed
+// frame stay in place
+//===================================================
+template <typename PointT, template <typename> class DebugPolicy>
+bool RobotLocatorT<PointT, DebugPolicy>::grabCloud(bool filter)
+{
+	vector<char> grabbed(cameras.size(), 0);
+
+	{
+		TaskGroup group(*taskPool);
+
+		for (size_t i = 1; i < cameras.size(); i++)
+		{
+			group.run([this, i, &grabbed]() { grabbed[i] = grabCamera(i); });
+		}
+
+		grabbed[0] = grabCamera(0);
+		group.wait();
+	}
+
+	if (find(grabbed.begin(), grabbed.end(), 0) != grabbed.end()) { return false; }
+
+	staticFrame = isStaticFrame();
+	if (staticFrame)
+	{
+		reusedFrames++;
+		return true;
+	}
+	reusedFrames = 0;
+
+	TaskGroup group(*taskPool);
+
+	for (size_t i = 1; i < cameras.size(); i++)
+	{
+		group.run([this, i, filter]() { processCamera(i, filter); });
+	}
+
+	processCamera(0, filter);
+	group.wait();
+
+	return true;
+}
+
+template <typename PointT, template <typename> class DebugPolicy>
+bool RobotLocatorT<PointT, DebugPolicy>::grabCamera(size_t index)
+{
+	DepthFrame& frame = depthFrames[index];
+	if (!cameras[index].source->grab(frame)) { return false; }
 
+	decimateDepthFrame(frame, resolveDecimation(params.depthDecimation, frame.intrinsics.width));
 
+	//-- Only measured once there is a result to reuse
+	depthChange[index] = (params.staticReuse && located) ?
+		depthChangeShare(frame, staticDepth[index], float(params.staticChange)) : 1.0;
+
+	return true;
+}
+
+template <typename PointT, template <typename> class DebugPolicy>
+void RobotLocatorT<PointT, DebugPolicy>::processCamera(size_t index, bool filter)
+{
+	DepthFrame& frame = depthFrames[index];
+
+	//-- Later frames are compared against this one as long as they are reused
+	if (params.staticReuse) { staticDepth[index] = frame.depth; }
+
+	//-- The windows are in the leveled frame of the first camera, and only hold for the resolution they were made at
+	bool culled = index == 0 && !depthWindows.empty() &&
+		depthWindows[0].columnNear.size() == size_t(frame.intrinsics.width) &&
+		depthWindows[0].rowNear.size() == size_t(frame.intrinsics.height);
+
+	if (culled) { deprojectDepthWindows(frame, depthWindows, *cameraClouds[index]); }
+	else { deprojectDepthFrame(frame, *cameraClouds[index]); }
+
+	//-- The strips around the ROIs hold too little floor for a ground fit, a fence face would outweigh it
+	if (index == 0)
+	{
+		groundSampled = culled;
+
+		if (culled)
+		{
+			CloudPtr sample(new Cloud);
+			deprojectDepthSample(frame, GROUND_SAMPLE_STEP, *sample);
+
+			ObjectROI passROI = PASS_ROI;
+			vector<int> passed;
+			indicesWithinROI(sample, passROI, passed);
+			parallelGather(*taskPool, *sample, passed, *groundSample);
+		}
+	}
+
+	if (!filter) { return; }
+
+	//-- Filter limits apply in the frame of each camera, then into the frame of the first one
+	filterCloud(cameraClouds[index], cameraFiltered[index]);
+
+	if (index > 0)
+	{
+		pcl::transformPointCloud(*cameraFiltered[index], *cameraFiltered[index], cameras[index].extrinsics);
+	}
+}
+
+template <typename PointT, template <typename> class DebugPolicy>
+bool RobotLocatorT<PointT, DebugPolicy>::isStaticFrame(void)
+{
+	//-- A stage change or a status set from outside needs a result of the stage in charge,
+	//-- and a refresh now and then keeps slow drift from piling up
+	if (!params.staticReuse || !located || status != result.status) { return false; }
+	if (reusedFrames >= params.staticMaxFrames) { return false; }
+
+	for (size_t i = 0; i < depthChange.size(); i++)
+	{
+		if (!(depthChange[i] < params.staticShare)) { return false; }
+	}
+
+	return true;
+}
+
+template <typename PointT, template <typename> class DebugPolicy>
+void RobotLocatorT<PointT, DebugPolicy>::requireFeatures(unsigned int features)
+{
+	//-- Pull in the features each requested one is derived from
+	if (features & FEATURE_PLANE_MAP) { features |= FEATURE_VERTICAL_NORMALS; }
+	if (features & FEATURE_VERTICAL_NORMALS) { features |= FEATURE_VERTICAL_CLOUD; }
+	if (features & FEATURE_VERTICAL_CLOUD)
+	{
+		//-- Height bands estimate the few normals they need themselves
+		features |= FEATURE_GROUND_PLANE;
+		if (params.horizontalRemoval == HORIZONTAL_REMOVAL_NORMALS) { features |= FEATURE_HORIZONTAL_NORMALS; }
+	}
+	if (features & FEATURE_HORIZONTAL_NORMALS) { features |= FEATURE_FILTERED_CLOUD; }
+	if (features & FEATURE_GROUND_PLANE) { features |= FEATURE_FILTERED_CLOUD; }
+
+	//-- Compute the missing ones in dependency order
+	if ((features & FEATURE_FILTERED_CLOUD) && !(readyFeatures & FEATURE_FILTERED_CLOUD))
+	{
+		preProcess();
+	}
+
+	bool needGround = (features & FEATURE_GROUND_PLANE) && !(readyFeatures & FEATURE_GROUND_PLANE);
+	bool needNormals = (features & FEATURE_HORIZONTAL_NORMALS) && !(readyFeatures & FEATURE_HORIZONTAL_NORMALS);
+
+	if (needGround)
+	{
+		//-- Normals do not depend on the ground plane, estimate them meanwhile and level them afterwards
+		TaskGroup group(*taskPool);
+
+		if (needNormals)
+		{
+			group.run([this]() { horizontalNormals = estimateNormals(filteredCloud, params.horizontalNormalRadius); });
+		}
+
+		updateGround();
+		group.wait();
+
+		//-- Rotate the point cloud to horizontal
+		rotatePointCloudToHorizontal(filteredCloud);
+		readyFeatures |= FEATURE_GROUND_PLANE;
+
+		if (needNormals)
+		{
+			Eigen::Matrix3f rotation = horizontalRotation().rotation();
+
+			for (size_t i = 0; i < horizontalNormals->points.size(); i++)
+			{
+				pcl::Normal& normal = horizontalNormals->points[i];
+				Eigen::Vector3f leveled = rotation * Eigen::Vector3f(normal.normal_x, normal.normal_y, normal.normal_z);
+
+				normal.normal_x = leveled[0];
+				normal.normal_y = leveled[1];
+				normal.normal_z = leveled[2];
+			}
+
+			readyFeatures |= FEATURE_HORIZONTAL_NORMALS;
+		}
+	}
+	else if (needNormals)
+	{
+		horizontalNormals = estimateNormals(filteredCloud, params.horizontalNormalRadius);
+		readyFeatures |= FEATURE_HORIZONTAL_NORMALS;
+	}
+
+	if ((features & FEATURE_VERTICAL_CLOUD) && !(readyFeatures & FEATURE_VERTICAL_CLOUD))
+	{
+		//-- Remove all horizontal planes
+		removeHorizontalPlane(filteredCloud);
+		readyFeatures |= FEATURE_VERTICAL_CLOUD;
+	}
+
+	if ((features & FEATURE_VERTICAL_NORMALS) && !(readyFeatures & FEATURE_VERTICAL_NORMALS))
+	{
+		verticalNormals = estimateNormals(verticalCloud, params.planeNormalRadius);
+		readyFeatures |= FEATURE_VERTICAL_NORMALS;
+	}
+
+	if ((features & FEATURE_PLANE_MAP) && !(readyFeatures & FEATURE_PLANE_MAP))
+	{
+		segmentPlanes<PointT>(verticalCloud, verticalNormals, params, planeSegments);
+		readyFeatures |= FEATURE_PLANE_MAP;
+	}
+}
+
+template <typename PointT, template <typename> class DebugPolicy>
+void RobotLocatorT<PointT, DebugPolicy>::locate(void)
+{
+	result.timestamp = depthFrames[0].timestamp;
+	result.number = depthFrames[0].number;
+	result.quality = scheduler.getLevel();
+	result.reused = staticFrame;
+
+	if (staticFrame)
+	{
+		//-- The stage would measure the same again, publish its values with this frame and cast its vote again
+		if (lastVote >= 0) { voteForNextStage(lastVote != 0); }
+
+		//-- No pipeline ran, the latency tells the scheduler nothing about the headroom of the next processed frame
+		result.latency = hostClockMs() - frameArrival();
+		return;
+	}
+
+	result.status = status;
+	result.detected = true;
+	result.xDistance = NAN;
+	result.zDistance = NAN;
+	result.duneDistance = NAN;
+	result.fenseDistance = NAN;
+	result.angle = NAN;
+	lastVote = -1;
+
+	//-- Stage graph, features are computed on demand and only once per frame
+	typedef RobotLocatorT<PointT, DebugPolicy> Locator;
+
+	static const LocatorStage<Locator> locatorStages[] =
+	{
+		{ STARTUP_INITIAL,          FEATURE_NONE,                                      STAGE_ROI_NONE,                           &Locator::locateStartupInitial },
+		{ BEFORE_DUNE_STAGE_1,      FEATURE_VERTICAL_CLOUD | FEATURE_VERTICAL_NORMALS, STAGE_ROI_LEFT_FENSE | STAGE_ROI_DUNE,    &Locator::locateBeforeDuneStage1 },
+		{ BEFORE_DUNE_STAGE_2,      FEATURE_VERTICAL_CLOUD | FEATURE_VERTICAL_NORMALS, STAGE_ROI_LEFT_FENSE | STAGE_ROI_DUNE,    &Locator::locateBeforeDuneStage2 },
+		{ BEFORE_DUNE_STAGE_3,      FEATURE_VERTICAL_CLOUD | FEATURE_VERTICAL_NORMALS, STAGE_ROI_DUNE,                           &Locator::locateBeforeDuneStage3 },
+		{ PASSING_DUNE,             FEATURE_VERTICAL_CLOUD,                            STAGE_ROI_FRONT_FENSE,                    &Locator::locatePassingDune },
+		{ BEFORE_GRASSLAND_STAGE_1, FEATURE_VERTICAL_CLOUD | FEATURE_VERTICAL_NORMALS, STAGE_ROI_FRONT_FENSE,                    &Locator::locateBeforeGrasslandStage1 },
+		{ BEFORE_GRASSLAND_STAGE_2, FEATURE_GROUND_PLANE,                              STAGE_ROI_NONE,                           &Locator::locateBeforeGrasslandStage2 }
+	};
+
+	unsigned int rois = STAGE_ROI_NONE;
+
+	for (size_t i = 0; i < sizeof(locatorStages) / sizeof(locatorStages[0]); i++)
+	{
+		if (locatorStages[i].status == status)
+		{
+			//-- Stages may fit several ROIs concurrently, nothing may be computed lazily from there
+			unsigned int features = locatorStages[i].features;
+			if ((features & FEATURE_VERTICAL_NORMALS) && params.planeDetector == PLANE_DETECTOR_SEGMENT_MAP)
+			{
+				features |= FEATURE_PLANE_MAP;
+			}
+
+			//-- Trace lines are fitted on the points alone
+			if (params.planeDetector == PLANE_DETECTOR_TRACE_LINE)
+			{
+				features &= ~FEATURE_VERTICAL_NORMALS;
+			}
+
+			requireFeatures(features);
+			(this->*locatorStages[i].locate)();
+			rois = locatorStages[i].rois;
+			break;
+		}
+	}
+
+	//-- A lost target or a new stage looks at the whole frame again
+	updateDepthWindows((result.detected && status == result.status) ? rois : STAGE_ROI_NONE);
+	located = true;
+
+	//-- Measured from the oldest frame that went into the result
+	result.latency = hostClockMs() - frameArrival();
+	scheduler.endFrame(result.latency);
+}
+
+template <typename PointT, template <typename> class DebugPolicy>
+double RobotLocatorT<PointT, DebugPolicy>::frameArrival(void)
+{
+	double arrival = depthFrames[0].arrival;
+	for (size_t i = 1; i < depthFrames.size(); i++) { arrival = min(arrival, depthFrames[i].arrival); }
+
+	return arrival;
+}
+
+template <typename PointT, template <typename> class DebugPolicy>
+pcl::PointCloud<pcl::Normal>::Ptr RobotLocatorT<PointT, DebugPolicy>::estimateNormals(CloudPtr cloud, double radius,
+	const vector<int>* indices)
+{
+	pcl::NormalEstimationOMP<PointT, pcl::Normal> ne;
+	ne.setNumberOfThreads(params.normalThreads);
+	ne.setInputCloud(cloud);
+
+	if (indices != NULL) { ne.setIndices(pcl::IndicesPtr(new vector<int>(*indices))); }
+
+	typename pcl::search::KdTree<PointT>::Ptr tree(new pcl::search::KdTree<PointT>());
+	ne.setSearchMethod(tree);
+
+	pcl::PointCloud<pcl::Normal>::Ptr normal(new pcl::PointCloud<pcl::Normal>);
+	ne.setRadiusSearch(radius);
+	ne.compute(*normal);
+
+	return normal;
+}
+
+template <typename PointT, template <typename> class DebugPolicy>
+void RobotLocatorT<PointT, DebugPolicy>::voteForNextStage(bool condition)
+{
+	//-- Move on only after the condition holds for several frames in a row
+	lastVote = condition ? 1 : 0;
+
+	if (condition) { nextStatusCounter++; }
+	else { nextStatusCounter = 0; }
+
+	if (nextStatusCounter >= 3) { status++; }
+}
+
+template <typename PointT, template <typename> class DebugPolicy>
+void RobotLocatorT<PointT, DebugPolicy>::updateViewer(void)
+{
+	//-- First thing to go when the frame runs late
+	if (!scheduler.isViewerEnabled()) { return; }
+
+	debugView.update();
+}
+
+template <typename PointT, template <typename> class DebugPolicy>
+void RobotLocatorT<PointT, DebugPolicy>::preProcess(void)
+{
+	filterCloud(srcCloud, filteredCloud);
+
+	readyFeatures |= FEATURE_FILTERED_CLOUD;
+}
+
+template <typename PointT, template <typename> class DebugPolicy>
+void RobotLocatorT<PointT, DebugPolicy>::mortonSort(CloudPtr cloud)
+{
+	vector<int> order;
+	mortonOrder(floatsOf(*cloud), strideOf(*cloud), cloud->points.size(), float(params.voxelLeaf), order);
+
+	Cloud ordered;
+	parallelGather(*taskPool, *cloud, order, ordered);
+	cloud->points.swap(ordered.points);
+}
+
+template <typename PointT, template <typename> class DebugPolicy>
+void RobotLocatorT<PointT, DebugPolicy>::filterCloud(CloudPtr cloud, CloudPtr filtered)
+{
+	//-- Pass through filter, both limits in one compaction
+
+	ObjectROI passROI = PASS_ROI;
+	vector<int> passed;
+
+	indicesWithinROI(cloud, passROI, passed);
+	parallelGather(*taskPool, *cloud, passed, *filtered);
+
+
+
+	//-- Down sampling
+
+	pcl::VoxelGrid<PointT> passVG;
+	passVG.setInputCloud(filtered);
+	passVG.setLeafSize(params.voxelLeaf, params.voxelLeaf, params.voxelLeaf);
+	passVG.filter(*filtered);
+
+	//-- Neighbors in space become neighbors in memory for the searches from here on,
+	//-- the compactions after this keep the order
+	if (params.mortonOrder) { mortonSort(filtered); }
+
+	//-- Remove outliers
+	//start = chrono::steady_clock::now();
+	pcl::StatisticalOutlierRemoval<PointT> passSOR;
+	passSOR.setInputCloud(filtered);
+	passSOR.setMeanK(params.sorMeanK);
+	passSOR.setStddevMulThresh(params.sorStddevMul);
+	passSOR.filter(*filtered);
 
 	// cout << double(totalTime.count()) / 1000.0f <<" "<<  double(totalTime1.count()) / 1000.0f <<" " <<double(totalTime2.count()) / 1000.0f <<" "<< endl;
 }
 
-pcl::ModelCoefficients::Ptr RobotLocator::extractGroundCoeff(pPointCloud cloud)
+template <typename PointT, template <typename> class DebugPolicy>
+pcl::ModelCoefficients::Ptr RobotLocatorT<PointT, DebugPolicy>::extractGroundCoeff(CloudPtr cloud)
 {
 	//-- Plane model segmentation
 	pcl::ModelCoefficients::Ptr coefficients(new pcl::ModelCoefficients);
 	pcl::PointIndices::Ptr inliers(new pcl::PointIndices);
 
-	pcl::SACSegmentation<pointType> seg;
+	pcl::SACSegmentation<PointT> seg;
 	seg.setOptimizeCoefficients(true);
 	seg.setModelType(pcl::SACMODEL_PLANE);
 	seg.setMethodType(pcl::SAC_RANSAC);
-	seg.setDistanceThreshold(0.01);
+	seg.setDistanceThreshold(params.ransacThreshold);
+	seg.setMaxIterations(params.ransacMaxIterations);
 
 	seg.setInputCloud(cloud);
 	seg.segment(*inliers, *coefficients);
 
 	//-- If plane coefficients changed a little, refresh it. else not
-	Vector3d vecNormalLast(groundCoeff->values[0], groundCoeff->values[1], groundCoeff->values[2]);
-	Vector3d vecNormalThis(coefficients->values[0], coefficients->values[1], coefficients->values[2]);
-	double angleCosine = abs(vecNormalLast.dot(vecNormalThis) / (vecNormalLast.norm() * vecNormalThis.norm()));
-
-	double originDistanceLast = groundCoeff->values[3] / vecNormalLast.norm();
-	double originDistanceThis = coefficients->values[3] / vecNormalThis.norm();
-	double distDifference = abs(originDistanceThis - originDistanceLast);
-
-	if (angleCosine > 0.8f && distDifference < 0.04f)
+	if (coefficients->values.size() == 4 &&
+		groundFitAgrees(groundCoeff->values.data(), coefficients->values.data(), params))
 	{
 		groundCoeff = coefficients;
 	}
@@ -187,25 +769,70 @@ pcl::ModelCoefficients::Ptr RobotLocator::extractGroundCoeff(pPointCloud cloud)
 	return groundCoeff;
 }
 
-pPointCloud RobotLocator::rotatePointCloudToHorizontal(pPointCloud cloud)
+template <typename PointT, template <typename> class DebugPolicy>
+void RobotLocatorT<PointT, DebugPolicy>::updateDepthWindows(unsigned int roiMask)
+{
+	depthWindows.clear();
+	if (!params.roiCulling || roiMask == STAGE_ROI_NONE) { return; }
+
+	const ObjectROI* rois[] = { &leftFenseROI, &duneROI, &frontFenseROI };
+	const unsigned int bits[] = { STAGE_ROI_LEFT_FENSE, STAGE_ROI_DUNE, STAGE_ROI_FRONT_FENSE };
+
+	//-- Nothing outside the pass through survives filterCloud anyway, x is the same before and after leveling
+	ObjectROI passROI = PASS_ROI;
+	float margin = float(params.roiCullMargin);
+
+	for (int i = 0; i < 3; i++)
+	{
+		if (!(roiMask & bits[i])) { continue; }
+
+		const float box[4] = { float(max(rois[i]->xMin, passROI.xMin - margin)), float(min(rois[i]->xMax, passROI.xMax + margin)),
+			float(rois[i]->zMin), float(rois[i]->zMax) };
+
+		depthWindows.push_back(DepthWindow());
+		makeDepthWindow(depthFrames[0].intrinsics, ground.angle, box, margin, float(passROI.zMax), depthWindows.back());
+	}
+}
+
+template <typename PointT, template <typename> class DebugPolicy>
+void RobotLocatorT<PointT, DebugPolicy>::updateGround(void)
 {
-	//-- Define the rotate angle about x-axis
-	double angleAlpha = atan(-groundCoeff->values[2] / groundCoeff->values[1]);
+	//-- A culled frame is fitted on the sample of the whole frame instead
+	CloudPtr groundSource = groundSampled ? groundSample : filteredCloud;
+
+	if (groundEstimator.isRunning())
+	{
+		//-- The estimator fits in the camera frame, so it samples the cloud before leveling
+		groundEstimator.offer(*groundSource, depthFrames[0].number, hostClockMs());
+
+		ground = *groundEstimator.snapshot();
+		groundCoeff->values.assign(ground.coefficients, ground.coefficients + 4);
+	}
+	else
+	{
+		extractGroundCoeff(groundSource);
+		makeGroundSnapshot(groundCoeff->values.data(), depthFrames[0].number, ground);
+	}
+}
 
-	//-- Define the rotate transform
+template <typename PointT, template <typename> class DebugPolicy>
+Eigen::Affine3f RobotLocatorT<PointT, DebugPolicy>::horizontalRotation(void)
+{
+	//-- Define the rotate transform about x-axis
 	Eigen::Affine3f rotateToXZPlane = Eigen::Affine3f::Identity();
-	rotateToXZPlane.rotate(Eigen::AngleAxisf(angleAlpha, Eigen::Vector3f::UnitX()));
+	rotateToXZPlane.rotate(Eigen::AngleAxisf(ground.angle, Eigen::Vector3f::UnitX()));
+
+	return rotateToXZPlane;
+}
 
+template <typename PointT, template <typename> class DebugPolicy>
+typename RobotLocatorT<PointT, DebugPolicy>::CloudPtr RobotLocatorT<PointT, DebugPolicy>::rotatePointCloudToHorizontal(CloudPtr cloud)
+{
 	//-- Apply transform
-	pcl::transformPointCloud(*cloud, *cloud, rotateToXZPlane);
+	pcl::transformPointCloud(*cloud, *cloud, horizontalRotation());
 
 	//-- Update rotated ground coefficients
-	Vector3d vecNormal(groundCoeff->values[0], groundCoeff->values[1], groundCoeff->values[2]);
-
-	groundCoeffRotated->values[0] = groundCoeff->values[0];
-	groundCoeffRotated->values[1] = -vecNormal.norm() * (groundCoeff->values[3] / abs(groundCoeff->values[3]));
-	groundCoeffRotated->values[2] = 0.0f;
-	groundCoeffRotated->values[3] = groundCoeff->values[3];
+	groundCoeffRotated->values.assign(ground.rotated, ground.rotated + 4);
 
 	// cout << "Ground coefficients: " << groundCoeffRotated->values[0] << " " 
 	//                                 << groundCoeffRotated->values[1] << " "
@@ -215,124 +842,266 @@ pPointCloud RobotLocator::rotatePointCloudToHorizontal(pPointCloud cloud)
 	return cloud;
 }
 
-pPointCloud RobotLocator::removeHorizontalPlane(pPointCloud cloud, bool onlyGround)
+template <typename PointT, template <typename> class DebugPolicy>
+typename RobotLocatorT<PointT, DebugPolicy>::CloudPtr RobotLocatorT<PointT, DebugPolicy>::removeHorizontalPlane(CloudPtr cloud, bool onlyGround)
 {
-	verticalCloud->clear();
-	dstCloud->clear();
-	pointType tmpPoint;
+	//-- The debug view may still hold the cloud of the last frame, start a new one instead of overwriting it
+	if (verticalCloud.unique()) { verticalCloud->clear(); }
+	else { verticalCloud.reset(new Cloud); }
 
-	//-- Vector of plane normal and every point on the plane
-	Vector3d vecNormal(groundCoeffRotated->values[0], groundCoeffRotated->values[1], groundCoeffRotated->values[2]);
-	Vector3d vecPoint(0, 0, 0);
+	//-- Unit ground normal and offset, estimated point normals are unit already
+	float plane[4];
+	normalizePlane(groundCoeffRotated->values.data(), plane);
+	const float horizontalCosine = float(params.horizontalCosine);
+	const float groundBand = float(params.groundBand);
 
 	// cout << "Ground coefficients: " << groundCoeffRotated->values[0] << " " 
 	//                                 << groundCoeffRotated->values[1] << " "
 	//                                 << groundCoeffRotated->values[2] << " " 
 	//                                 << groundCoeffRotated->values[3] << endl;
 
-	//-- Plane normal estimating
-	pcl::NormalEstimationOMP<pointType, pcl::Normal> ne;
-	ne.setInputCloud(cloud);
-
-	pcl::search::KdTree<pointType>::Ptr tree(new pcl::search::KdTree<pointType>());
-	ne.setSearchMethod(tree);
-
-	pcl::PointCloud<pcl::Normal>::Ptr normal(new pcl::PointCloud<pcl::Normal>);
-	ne.setRadiusSearch(0.03); /* setKSearch function can be try */
-	ne.compute(*normal);
+	vector<int> vertical;
 
-	//-- Compare point normal and plane normal, remove every point on a horizontal plane
-
-	for (size_t i = 0; i < cloud->points.size(); i++)
+	if (params.horizontalRemoval == HORIZONTAL_REMOVAL_HEIGHT_BANDS)
+	{
+		selectByHeight(cloud, onlyGround, plane, vertical);
+	}
+	else
 	{
-		vecPoint[0] = normal->points[i].normal_x;
-		vecPoint[1] = normal->points[i].normal_y;
-		vecPoint[2] = normal->points[i].normal_z;
+		//-- Plane normal estimating, the filtered cloud shares one estimation per frame
+		pcl::PointCloud<pcl::Normal>::Ptr normal;
 
-		if (onlyGround == false)
+		if (cloud == filteredCloud && (readyFeatures & FEATURE_HORIZONTAL_NORMALS))
 		{
-			double angleCosine = abs(vecNormal.dot(vecPoint) / (vecNormal.norm() * vecPoint.norm()));
-
-			if (angleCosine < 0.90)
-			{
-				verticalCloud->points.push_back(cloud->points[i]);
-			}
+			normal = horizontalNormals;
 		}
 		else
 		{
-			double angleCosine = abs(vecNormal.dot(vecPoint) / (vecNormal.norm() * vecPoint.norm()));
-			double distanceToPlane = abs(groundCoeffRotated->values[0] * cloud->points[i].x +
-				groundCoeffRotated->values[1] * cloud->points[i].y +
-				groundCoeffRotated->values[2] * cloud->points[i].z +
-				groundCoeffRotated->values[3]) / vecNormal.norm();
+			normal = estimateNormals(cloud, params.horizontalNormalRadius); /* setKSearch function can be try */
+		}
+
+		//-- Compare point normal and plane normal, remove every point on a horizontal plane
+		const float* normals = floatsOf(*normal);
+		const float* points = floatsOf(*cloud);
+		const size_t normalStride = strideOf(*normal);
+		const size_t pointStride = strideOf(*cloud);
+
+		parallelSelectMasked(*taskPool, cloud->points.size(), [&](size_t begin, size_t end, uint8_t* flags)
+		{
+			cosineMask(normals + begin * normalStride, normalStride, NULL, end - begin, plane, horizontalCosine, false, flags + begin);
 
-			if (angleCosine < 0.90 || distanceToPlane > 0.05)
+			//-- Off the ground band counts as vertical too
+			if (onlyGround)
 			{
-				verticalCloud->points.push_back(cloud->points[i]);
+				uint8_t offGround[PARALLEL_FILTER_CHUNK];
+				distanceMask(points + begin * pointStride, pointStride, NULL, end - begin, plane, groundBand, true, offGround);
+				maskOr(flags + begin, offGround, end - begin);
 			}
-		}
+		}, vertical);
 	}
 
+	parallelGather(*taskPool, *cloud, vertical, *verticalCloud);
+
 
 	//-- Remove Outliers
 
-	pcl::StatisticalOutlierRemoval<pointType> passSOR;
+	pcl::StatisticalOutlierRemoval<PointT> passSOR;
 	passSOR.setInputCloud(verticalCloud);
-	passSOR.setMeanK(20);
-	passSOR.setStddevMulThresh(0.05);
+	passSOR.setMeanK(params.verticalSorMeanK);
+	passSOR.setStddevMulThresh(params.verticalSorStddevMul);
 	passSOR.filter(*verticalCloud);
 
 
 
-	//-- Copy points from verticalCloud to dstCloud
-	for (size_t i = 0; i < verticalCloud->points.size(); i++)
-	{
-		tmpPoint = verticalCloud->points[i];
-		tmpPoint.r = 0;
-		tmpPoint.g = 0;
-		tmpPoint.b = 0;
-		dstCloud->points.push_back(tmpPoint);
-	}
+	//-- Labels of this frame index into verticalCloud
+	debugView.reset(verticalCloud);
 
 	return verticalCloud;
 }
 
-pPointCloud RobotLocator::extractVerticalCloud(pPointCloud cloud)
+//-- Classes of the height band cells
+#define HEIGHT_CELL_FLAT           0
+#define HEIGHT_CELL_TALL           1
+#define HEIGHT_CELL_MIXED          2
+
+//-- Fewer points tell nothing about the spread
+#define HEIGHT_CELL_MIN_POINTS     3
+
+typedef struct
+{
+	int    count;
+	double sum;
+	double sumSquares;
+
+} HeightCell;
+
+//===================================================
+// selectByHeight
+// - Heights above the ground in one kernel pass,
+// then the height spread of each x-z grid cell says
+// whether its points lie on one horizontal surface,
+// on a vertical structure or on both, only points of
+// the last kind need normals
+//===================================================
+template <typename PointT, template <typename> class DebugPolicy>
+void RobotLocatorT<PointT, DebugPolicy>::selectByHeight(CloudPtr cloud, bool onlyGround, const float plane[4],
+	vector<int>& vertical)
 {
-	extractGroundCoeff(cloud);
+	const size_t count = cloud->points.size();
+	const float* points = floatsOf(*cloud);
+	const size_t pointStride = strideOf(*cloud);
+	const float groundBand = float(params.groundBand);
+	const float cell = float(params.heightCell);
+
+	vector<float> heights(count);
+	planeDistance(points, pointStride, NULL, count, plane, heights.data());
+
+	//-- Grid over the x-z extent of the cloud
+	float xMin = INFINITY, xMax = -INFINITY, zMin = INFINITY, zMax = -INFINITY;
+	for (size_t i = 0; i < count; i++)
+	{
+		const PointT& point = cloud->points[i];
+		if (!std::isfinite(point.x) || !std::isfinite(point.z)) { continue; }
+
+		xMin = min(xMin, point.x);
+		xMax = max(xMax, point.x);
+		zMin = min(zMin, point.z);
+		zMax = max(zMax, point.z);
+	}
 
-	//-- Rotate the point cloud to horizontal
-	rotatePointCloudToHorizontal(cloud);
+	vertical.clear();
+	if (!(xMin <= xMax)) { return; }
 
-	//-- Remove all horizontal planes
+	const int columns = int((xMax - xMin) / cell) + 1;
+	const int rows = int((zMax - zMin) / cell) + 1;
 
-	removeHorizontalPlane(cloud);
-	return verticalCloud;
+	vector<HeightCell> cells(size_t(columns) * rows, HeightCell());
+	vector<int> cellIndices(count, -1);
+
+	for (size_t i = 0; i < count; i++)
+	{
+		const PointT& point = cloud->points[i];
+		if (!std::isfinite(point.x) || !std::isfinite(point.z)) { continue; }
+
+		int column = min(columns - 1, int((point.x - xMin) / cell));
+		int row = min(rows - 1, int((point.z - zMin) / cell));
+		cellIndices[i] = row * columns + column;
+
+		HeightCell& heightCell = cells[cellIndices[i]];
+		heightCell.count++;
+		heightCell.sum += heights[i];
+		heightCell.sumSquares += double(heights[i]) * heights[i];
+	}
+
+	vector<uint8_t> cellClasses(cells.size(), HEIGHT_CELL_MIXED);
+	for (size_t c = 0; c < cells.size(); c++)
+	{
+		const HeightCell& heightCell = cells[c];
+		if (heightCell.count < HEIGHT_CELL_MIN_POINTS) { continue; }
+
+		double mean = heightCell.sum / heightCell.count;
+		double deviation = sqrt(max(0.0, heightCell.sumSquares / heightCell.count - mean * mean));
+
+		if (deviation < params.flatStddev) { cellClasses[c] = HEIGHT_CELL_FLAT; }
+		else if (deviation > params.tallStddev) { cellClasses[c] = HEIGHT_CELL_TALL; }
+	}
 
+	//-- Flat cells go, tall cells stay above the ground band, mixed cells ask the normals
+	vector<uint8_t> keep(count, 0);
+	vector<int> ambiguous;
+
+	for (size_t i = 0; i < count; i++)
+	{
+		if (cellIndices[i] < 0) { continue; }
+
+		bool offGround = !(fabs(heights[i]) < groundBand);
+
+		switch (cellClasses[cellIndices[i]])
+		{
+		case HEIGHT_CELL_FLAT:
+			keep[i] = (onlyGround && offGround) ? 1 : 0;
+			break;
+		case HEIGHT_CELL_TALL:
+			keep[i] = offGround ? 1 : 0;
+			break;
+		default:
+			if (onlyGround && offGround) { keep[i] = 1; }
+			else { ambiguous.push_back(int(i)); }
+			break;
+		}
+	}
+
+	if (!ambiguous.empty())
+	{
+		const float horizontalCosine = float(params.horizontalCosine);
+		vector<uint8_t> notHorizontal(ambiguous.size());
+
+		if (cloud == filteredCloud && (readyFeatures & FEATURE_HORIZONTAL_NORMALS))
+		{
+			cosineMask(floatsOf(*horizontalNormals), strideOf(*horizontalNormals), ambiguous.data(), ambiguous.size(),
+				plane, horizontalCosine, false, notHorizontal.data());
+		}
+		else
+		{
+			pcl::PointCloud<pcl::Normal>::Ptr normal = estimateNormals(cloud, params.horizontalNormalRadius, &ambiguous);
+			cosineMask(floatsOf(*normal), strideOf(*normal), NULL, ambiguous.size(),
+				plane, horizontalCosine, false, notHorizontal.data());
+		}
+
+		for (size_t k = 0; k < ambiguous.size(); k++) { keep[ambiguous[k]] = notHorizontal[k]; }
+	}
+
+	parallelSelect(*taskPool, count, [&](size_t i) { return keep[i] != 0; }, vertical);
 }
 
-void RobotLocator::extractPlaneWithinROI(pPointCloud cloud, ObjectROI roi,
+template <typename PointT, template <typename> class DebugPolicy>
+bool RobotLocatorT<PointT, DebugPolicy>::extractPlaneWithinROI(CloudPtr cloud, ObjectROI roi,
 	pcl::PointIndices::Ptr indices, pcl::ModelCoefficients::Ptr coefficients)
 {
-	//-- Get point cloud indices inside given ROI
-	pcl::PassThrough<pointType> pass;
-	pass.setInputCloud(cloud);
-	pass.setFilterFieldName("x");
-	pass.setFilterLimits(roi.xMin, roi.xMax);
-	pass.filter(indicesROI->indices);
+	//-- The plane map covers the vertical cloud only
+	if (params.planeDetector == PLANE_DETECTOR_SEGMENT_MAP && cloud == verticalCloud)
+	{
+		return selectPlaneSegment(roi, indices, coefficients);
+	}
 
-	pass.setInputCloud(cloud);
-	pass.setFilterFieldName("z");
-	pass.setFilterLimits(roi.zMin, roi.zMax);
-	pass.setIndices(indicesROI);
-	pass.filter(indicesROI->indices);
+	//-- Get point cloud indices inside given ROI, local as ROIs may be fitted concurrently
+	pcl::PointIndices::Ptr indicesROI(new pcl::PointIndices);
+	indicesWithinROI(cloud, roi, indicesROI->indices);
+
+	//-- Faces of the leveled cloud are told apart by their x-z trace, the plane follows from the line
+	if (params.planeDetector == PLANE_DETECTOR_TRACE_LINE)
+	{
+		float plane[4];
+		const float planeDistance = float(params.planeDistance);
+		const float* points = floatsOf(*cloud);
+		const size_t pointStride = strideOf(*cloud);
+		const int* candidates = indicesROI->indices.data();
+
+		if (!fitTracePlane(points, pointStride, candidates, indicesROI->indices.size(),
+			float(params.ransacThreshold), planeDistance, params.ransacMaxIterations, plane))
+		{
+			indices->indices.clear();
+			coefficients->values.clear();
+			return false;
+		}
+
+		coefficients->values.assign(plane, plane + 4);
+
+		parallelSelectMasked(*taskPool, indicesROI->indices.size(), [&](size_t begin, size_t end, uint8_t* flags)
+		{
+			distanceMask(points, pointStride, candidates + begin, end - begin, plane, planeDistance, false, flags + begin);
+		}, indices->indices, candidates);
+
+		return !indices->indices.empty();
+	}
 
 	//-- Plane model segmentation
-	pcl::SACSegmentation<pointType> seg;
+	pcl::SACSegmentation<PointT> seg;
 	seg.setOptimizeCoefficients(true);
 	seg.setModelType(pcl::SACMODEL_PLANE);
 	seg.setMethodType(pcl::SAC_RANSAC);
-	seg.setDistanceThreshold(0.01);
+	seg.setDistanceThreshold(params.ransacThreshold);
+	seg.setMaxIterations(params.ransacMaxIterations);
 	seg.setIndices(indicesROI);
 
 	seg.setInputCloud(cloud);
@@ -340,48 +1109,113 @@ void RobotLocator::extractPlaneWithinROI(pPointCloud cloud, ObjectROI roi,
 
 	if (coefficients->values.size() == 0)
 	{
-		//-- TODO: If tracking failed
+		//-- Tracking failed, nothing to measure in this frame
+		indices->indices.clear();
+		return false;
+	}
+
+	//-- Unit plane normal and offset, estimated point normals are unit already
+	float plane[4];
+	normalizePlane(coefficients->values.data(), plane);
+	const float planeCosine = float(params.planeCosine);
+	const float planeDistance = float(params.planeDistance);
 
+	//-- Plane normal estimating, the vertical cloud shares one estimation per frame
+	pcl::PointCloud<pcl::Normal>::Ptr normal;
+
+	if (cloud == verticalCloud)
+	{
+		requireFeatures(FEATURE_VERTICAL_NORMALS);
+		normal = verticalNormals;
+	}
+	else
+	{
+		normal = estimateNormals(cloud, params.planeNormalRadius);
 	}
 
-	//-- Vector of plane normal and every point on the plane
-	Vector3d vecNormal(coefficients->values[0], coefficients->values[1], coefficients->values[2]);
-	Vector3d vecPoint(0, 0, 0);
+	//-- Compare point normal and position, extract indices of points meeting the criteria
+	const float* normals = floatsOf(*normal);
+	const float* points = floatsOf(*cloud);
+	const size_t normalStride = strideOf(*normal);
+	const size_t pointStride = strideOf(*cloud);
+	const int* candidates = indicesROI->indices.data();
 
-	//-- Plane normal estimating
-	pcl::NormalEstimationOMP<pointType, pcl::Normal> ne;
-	ne.setInputCloud(cloud);
+	parallelSelectMasked(*taskPool, indicesROI->indices.size(), [&](size_t begin, size_t end, uint8_t* flags)
+	{
+		uint8_t nearPlane[PARALLEL_FILTER_CHUNK];
 
-	pcl::search::KdTree<pointType>::Ptr tree(new pcl::search::KdTree<pointType>());
-	ne.setSearchMethod(tree);
+		cosineMask(normals, normalStride, candidates + begin, end - begin, plane, planeCosine, true, flags + begin);
+		distanceMask(points, pointStride, candidates + begin, end - begin, plane, planeDistance, false, nearPlane);
+		maskAnd(flags + begin, nearPlane, end - begin);
+	}, indices->indices, candidates);
 
-	pcl::PointCloud<pcl::Normal>::Ptr normal(new pcl::PointCloud<pcl::Normal>);
-	ne.setRadiusSearch(0.04);
-	ne.compute(*normal);
+	return !indices->indices.empty();
+}
+
+template <typename PointT, template <typename> class DebugPolicy>
+void RobotLocatorT<PointT, DebugPolicy>::indicesWithinROI(CloudPtr cloud, ObjectROI roi, vector<int>& indices)
+{
+	//-- Inclusive limits like PassThrough, NaN points fail every comparison
+	const float box[4] = { float(roi.xMin), float(roi.xMax), float(roi.zMin), float(roi.zMax) };
+	const float* points = floatsOf(*cloud);
+	const size_t stride = strideOf(*cloud);
+
+	parallelSelectMasked(*taskPool, cloud->points.size(), [&](size_t begin, size_t end, uint8_t* flags)
+	{
+		boxMask(points + begin * stride, stride, NULL, end - begin, box, flags + begin);
+	}, indices);
+}
+
+template <typename PointT, template <typename> class DebugPolicy>
+bool RobotLocatorT<PointT, DebugPolicy>::selectPlaneSegment(ObjectROI roi, pcl::PointIndices::Ptr indices,
+	pcl::ModelCoefficients::Ptr coefficients, Vector3d axis, double minCosine)
+{
+	requireFeatures(FEATURE_PLANE_MAP);
 
 	indices->indices.clear();
+	coefficients->values.clear();
 
-	//-- Compare point normal and position, extract indices of points meeting the criteria
-	for (size_t i = 0; i < indicesROI->indices.size(); i++)
+	vector<int> indicesInROI;
+
+	for (size_t i = 0; i < planeSegments.size(); i++)
 	{
-		vecPoint[0] = normal->points[indicesROI->indices[i]].normal_x;
-		vecPoint[1] = normal->points[indicesROI->indices[i]].normal_y;
-		vecPoint[2] = normal->points[indicesROI->indices[i]].normal_z;
+		const PlaneSegment& segment = planeSegments[i];
 
-		double angleCosine = abs(vecNormal.dot(vecPoint) / (vecNormal.norm() * vecPoint.norm()));
-		double distanceToPlane = abs(coefficients->values[0] * cloud->points[indicesROI->indices[i]].x +
-			coefficients->values[1] * cloud->points[indicesROI->indices[i]].y +
-			coefficients->values[2] * cloud->points[indicesROI->indices[i]].z +
-			coefficients->values[3]) / vecNormal.norm();
+		//-- Bounding box apart from the ROI
+		if (segment.maxPoint[0] < roi.xMin || segment.minPoint[0] > roi.xMax ||
+			segment.maxPoint[2] < roi.zMin || segment.minPoint[2] > roi.zMax)
+		{
+			continue;
+		}
+
+		Vector3d vecNormal(segment.coefficients[0], segment.coefficients[1], segment.coefficients[2]);
+		if (axis.norm() > 0.0 && abs(vecNormal.dot(axis)) / axis.norm() < minCosine) { continue; }
+
+		//-- Count the part inside the ROI, the largest one wins
+		indicesInROI.clear();
+
+		for (size_t j = 0; j < segment.inliers->indices.size(); j++)
+		{
+			const PointT& point = verticalCloud->points[segment.inliers->indices[j]];
+
+			if (point.x >= roi.xMin && point.x <= roi.xMax && point.z >= roi.zMin && point.z <= roi.zMax)
+			{
+				indicesInROI.push_back(segment.inliers->indices[j]);
+			}
+		}
 
-		if (angleCosine > 0.80 && distanceToPlane < 0.10)
+		if (indicesInROI.size() > indices->indices.size())
 		{
-			indices->indices.push_back(indicesROI->indices[i]);
+			indices->indices.swap(indicesInROI);
+			coefficients->values.assign(segment.coefficients.data(), segment.coefficients.data() + 4);
 		}
 	}
+
+	return !indices->indices.empty();
 }
 
-ObjectROI RobotLocator::updateObjectROI(pPointCloud cloud, pcl::PointIndices::Ptr indices,
+template <typename PointT, template <typename> class DebugPolicy>
+ObjectROI RobotLocatorT<PointT, DebugPolicy>::updateObjectROI(CloudPtr cloud, pcl::PointIndices::Ptr indices,
 	double xMinus, double xPlus, double zMinus, double zPlus)
 {
 	ObjectROI objROI;
@@ -398,7 +1232,21 @@ ObjectROI RobotLocator::updateObjectROI(pPointCloud cloud, pcl::PointIndices::Pt
 	return objROI;
 }
 
-void RobotLocator::locateBeforeDuneStage1(void)
+//-- Whether a fit on one ROI stands in for a fit on the other
+static bool roiClose(const ObjectROI& a, const ObjectROI& b, double tolerance)
+{
+	return abs(a.xMin - b.xMin) <= tolerance && abs(a.xMax - b.xMax) <= tolerance &&
+		abs(a.zMin - b.zMin) <= tolerance && abs(a.zMax - b.zMax) <= tolerance;
+}
+
+template <typename PointT, template <typename> class DebugPolicy>
+void RobotLocatorT<PointT, DebugPolicy>::locateStartupInitial(void)
+{
+	status = BEFORE_GRASSLAND_STAGE_2;
+}
+
+template <typename PointT, template <typename> class DebugPolicy>
+void RobotLocatorT<PointT, DebugPolicy>::locateBeforeDuneStage1(void)
 {
 	//chrono::steady_clock::time_point start;
 	//chrono::steady_clock::time_point stop;
@@ -409,21 +1257,37 @@ void RobotLocator::locateBeforeDuneStage1(void)
 	//auto totalTime5= chrono::duration_cast<chrono::microseconds>(stop - start);
 
    // start = chrono::steady_clock::now();
-	extractVerticalCloud(filteredCloud);
 	//stop = chrono::steady_clock::now();
 	 //totalTime3= chrono::duration_cast<chrono::microseconds>(stop - start);
 	//-- Perform the plane segmentation with specific indices
 	pcl::PointIndices::Ptr inliers(new pcl::PointIndices);
 	pcl::ModelCoefficients::Ptr coefficients(new pcl::ModelCoefficients);
 
+	//-- The dune ROI hangs off the fense ROI, crop it with the fense of the last frame meanwhile
+	auto duneROIOf = [](const ObjectROI& fense)
+	{
+		ObjectROI roi = { fense.xMax - 0.2, fense.xMax + 0.9, fense.zMin + 0.3, fense.zMax + 0.9 };
+		return roi;
+	};
+
+	ObjectROI speculativeROI = duneROIOf(leftFenseROI);
+	pcl::PointIndices::Ptr duneIndices(new pcl::PointIndices);
+
+	TaskGroup group(*taskPool);
+	group.run([this, speculativeROI, duneIndices]() { indicesWithinROI(verticalCloud, speculativeROI, duneIndices->indices); });
+
 	//start = chrono::steady_clock::now();
-	extractPlaneWithinROI(verticalCloud, leftFenseROI, inliers, coefficients);
+	if (!extractPlaneWithinROI(verticalCloud, leftFenseROI, inliers, coefficients))
+	{
+		result.detected = false;
+		updateViewer();
+		return;
+	}
 	leftFenseROI = updateObjectROI(verticalCloud, inliers, 0.1, 0.1, 0.3, 0.3);
 
 	Vector3d normalleft(coefficients->values[0], coefficients->values[1], coefficients->values[2]);
 
-	Vector3d vecNormal = Vector3d(groundCoeffRotated->values[0], groundCoeffRotated->values[1], groundCoeffRotated->values[2]);
-	double cameraHeight = abs(groundCoeffRotated->values[3]) / vecNormal.norm();
+	double cameraHeight = ground.cameraHeight;
 
 	double xDistance = (coefficients->values[1] * (cameraHeight - 0.05) + coefficients->values[3]) / coefficients->values[0];
 
@@ -444,44 +1308,27 @@ void RobotLocator::locateBeforeDuneStage1(void)
 	// cout << "xMin_  " << leftFenseROI.xMin << "  xMax_  " << leftFenseROI.xMax << 
 	//         "  zMin_  " << leftFenseROI.zMin << "  zMax_  " << leftFenseROI.zMax << endl;
 
-	//-- Change the color of the extracted part for debuging
-	for (int i = 0; i < inliers->indices.size(); i++)
-	{
-		dstCloud->points[inliers->indices[i]].r = 234;
-		dstCloud->points[inliers->indices[i]].g = 67;
-		dstCloud->points[inliers->indices[i]].b = 53;
-	}
+	//-- Label the extracted part for debuging
+	debugView.paint(inliers->indices, DEBUG_LABEL_FENSE);
 
-	duneROI.xMin = leftFenseROI.xMax - 0.2;
-	duneROI.xMax = leftFenseROI.xMax + 0.9;
-	duneROI.zMin = leftFenseROI.zMin + 0.3;
-	duneROI.zMax = leftFenseROI.zMax + 0.9;
+	duneROI = duneROIOf(leftFenseROI);
 
-	//-- Get point cloud indices inside given ROI
+	//-- Get point cloud indices inside given ROI, crop again if the fense moved too far
 	//start = chrono::steady_clock::now();
-	pcl::PassThrough<pointType> pass;
-	pass.setInputCloud(verticalCloud);
-	pass.setFilterFieldName("x");
-	pass.setFilterLimits(duneROI.xMin, duneROI.xMax);
-	pass.filter(inliers->indices);
+	group.wait();
 
-	pass.setInputCloud(verticalCloud);
-	pass.setFilterFieldName("z");
-	pass.setFilterLimits(duneROI.zMin, duneROI.zMax);
-	pass.setIndices(inliers);
-	pass.filter(inliers->indices);
+	if (!roiClose(duneROI, speculativeROI, params.speculativeTolerance))
+	{
+		indicesWithinROI(verticalCloud, duneROI, duneIndices->indices);
+	}
+	inliers = duneIndices;
 
 	//stop = chrono::steady_clock::now();
 	//totalTime1 = chrono::duration_cast<chrono::microseconds>(stop - start);
 
-	// -- Change the color of the extracted part for debuging
+	// -- Label the extracted part for debuging
 	// start = chrono::steady_clock::now();
-	for (int i = 0; i < inliers->indices.size(); i++)
-	{
-		dstCloud->points[inliers->indices[i]].r = 251;
-		dstCloud->points[inliers->indices[i]].g = 188;
-		dstCloud->points[inliers->indices[i]].b = 5;
-	}
+	debugView.paint(inliers->indices, DEBUG_LABEL_DUNE);
 
 	Eigen::Vector4f minVector, maxVector;
 	pcl::getMinMax3D(*verticalCloud, *inliers, minVector, maxVector);
@@ -489,81 +1336,105 @@ void RobotLocator::locateBeforeDuneStage1(void)
 	// stop = chrono::steady_clock::now();
 	//totalTime2 = chrono::duration_cast<chrono::microseconds>(stop - start);
 
-	if (minVector[2] < 1.80f) { nextStatusCounter++; }
-	else { nextStatusCounter = 0; }
+	voteForNextStage(minVector[2] < 1.80f);
 
-	if (nextStatusCounter >= 3) { status++; }
+	//-- No dune in sight leaves minVector at its initial value
+	result.detected = !inliers->indices.empty();
+	result.zDistance = result.detected ? minVector[2] : NAN;
+	result.xDistance = xDistance;
+	result.angle = plus_minus * acos(angleCosine) / PI * 180;
 
-	cout << minVector[2] << " " << xDistance << " " << plus_minus * acos(angleCosine) / PI * 180 << endl;
+	if (interactive) { cout << minVector[2] << " " << xDistance << " " << plus_minus * acos(angleCosine) / PI * 180 << endl; }
 
-	dstViewer->updatePointCloud(dstCloud, "Destination Cloud");
-	dstViewer->spinOnce(1);
+	updateViewer();
 
 	//cout << double(totalTime.count()) / 1000.0f <<" "<<  double(totalTime1.count()) / 1000.0f <<" " <<double(totalTime2.count()) / 1000.0f <<" "<<double(totalTime3.count()) / 1000.0f << endl;
 }
 
-void RobotLocator::locateBeforeDuneStage2(void)
+template <typename PointT, template <typename> class DebugPolicy>
+void RobotLocatorT<PointT, DebugPolicy>::locateBeforeDuneStage2(void)
 {
-
-	extractVerticalCloud(filteredCloud);
-
 	//-- Perform the plane segmentation with specific indices
 	pcl::PointIndices::Ptr inliers(new pcl::PointIndices);
 	pcl::ModelCoefficients::Ptr coefficients(new pcl::ModelCoefficients);
 
+	//-- The dune ROI hangs off the fense ROI, fit it with the fense of the last frame meanwhile
+	auto duneROIOf = [](const ObjectROI& fense)
+	{
+		ObjectROI roi = { fense.xMax - 0.3, fense.xMax + 0.9, fense.zMax - 0.3, fense.zMax + 0.9 };
+		return roi;
+	};
 
-	extractPlaneWithinROI(verticalCloud, leftFenseROI, inliers, coefficients);
+	ObjectROI speculativeROI = duneROIOf(leftFenseROI);
+	pcl::PointIndices::Ptr duneInliers(new pcl::PointIndices);
+	pcl::ModelCoefficients::Ptr duneCoefficients(new pcl::ModelCoefficients);
+	bool duneFound = false;
 
+	TaskGroup group(*taskPool);
+	group.run([this, speculativeROI, duneInliers, duneCoefficients, &duneFound]()
+	{
+		duneFound = extractPlaneWithinROI(verticalCloud, speculativeROI, duneInliers, duneCoefficients);
+	});
 
+	if (!extractPlaneWithinROI(verticalCloud, leftFenseROI, inliers, coefficients))
+	{
+		result.detected = false;
+		updateViewer();
+		return;
+	}
 
 	Vector3d vecNormal(coefficients->values[0], coefficients->values[1], coefficients->values[2]);
 	Vector3d vecXAxis(1.0, 0.0, 0.0);
 
 	double angleCosine = abs(vecNormal.dot(vecXAxis) / (vecNormal.norm() * vecXAxis.norm()));
 
-	if (angleCosine < 0.9)
+	if (angleCosine < 0.9 && params.planeDetector == PLANE_DETECTOR_SEGMENT_MAP)
 	{
-		//-- Extract indices for the rest part
-		pcl::ExtractIndices<pointType> extract;
-
-		extract.setInputCloud(verticalCloud);
-		extract.setIndices(inliers);
-		extract.setNegative(true);
-		extract.filter(inliers->indices);
-
-		//-- Get point cloud indices inside given ROI
-
-		pcl::PassThrough<pointType> pass;
-		pass.setInputCloud(verticalCloud);
-		pass.setFilterFieldName("x");
-		pass.setFilterLimits(leftFenseROI.xMin, leftFenseROI.xMax);
-		pass.setIndices(inliers);
-		pass.filter(inliers->indices);
-
-
-
+		//-- Take the largest segment facing the x-axis instead
+		if (!selectPlaneSegment(leftFenseROI, inliers, coefficients, vecXAxis, 0.9))
+		{
+			result.detected = false;
+			updateViewer();
+			return;
+		}
+	}
+	else if (angleCosine < 0.9)
+	{
+		//-- Indices of the rest part inside given ROI, in one compaction
+		vector<uint8_t> isRest(verticalCloud->points.size(), 1);
+		for (size_t i = 0; i < inliers->indices.size(); i++) { isRest[inliers->indices[i]] = 0; }
 
-		pass.setInputCloud(verticalCloud);
-		pass.setFilterFieldName("z");
-		pass.setFilterLimits(leftFenseROI.zMin, leftFenseROI.zMax);
-		pass.setIndices(inliers);
-		pass.filter(inliers->indices);
+		const float box[4] = { float(leftFenseROI.xMin), float(leftFenseROI.xMax), float(leftFenseROI.zMin), float(leftFenseROI.zMax) };
+		const float* points = floatsOf(*verticalCloud);
+		const size_t stride = strideOf(*verticalCloud);
 
+		parallelSelectMasked(*taskPool, verticalCloud->points.size(), [&](size_t begin, size_t end, uint8_t* flags)
+		{
+			boxMask(points + begin * stride, stride, NULL, end - begin, box, flags + begin);
+			maskAnd(flags + begin, isRest.data() + begin, end - begin);
+		}, inliers->indices);
 
 
 		//-- Plane model segmentation
 
-		pcl::SACSegmentation<pointType> seg;
+		pcl::SACSegmentation<PointT> seg;
 		seg.setOptimizeCoefficients(true);
 		seg.setModelType(pcl::SACMODEL_PLANE);
 		seg.setMethodType(pcl::SAC_RANSAC);
-		seg.setDistanceThreshold(0.01);
+		seg.setDistanceThreshold(params.ransacThreshold);
+		seg.setMaxIterations(params.ransacMaxIterations);
 		seg.setIndices(inliers);
 
 
 		seg.setInputCloud(verticalCloud);
 		seg.segment(*inliers, *coefficients);
 
+		if (coefficients->values.size() == 0)
+		{
+			result.detected = false;
+			updateViewer();
+			return;
+		}
 	}
 
 	leftFenseROI = updateObjectROI(verticalCloud, inliers, 0.1, 0.1, 0.3, 0.3);
@@ -578,7 +1449,7 @@ void RobotLocator::locateBeforeDuneStage2(void)
 	else plus_minus = 1;
 	//-- Calculate the distance to leftsense along the x-axis
 	vecNormal = Vector3d(groundCoeffRotated->values[0], groundCoeffRotated->values[1], groundCoeffRotated->values[2]);
-	double cameraHeight = abs(groundCoeffRotated->values[3]) / vecNormal.norm();
+	double cameraHeight = ground.cameraHeight;
 
 	//-- The formula of dune is ax + by + cz + d = 0, which z = 0.0 and y = cameraHeight - 0.05
 	double xDistance = (coefficients->values[1] * (cameraHeight - 0.05) + coefficients->values[3]) / coefficients->values[0];
@@ -586,29 +1457,37 @@ void RobotLocator::locateBeforeDuneStage2(void)
 	// cout << "xMin_  " << leftFenseROI.xMin << "  xMax_  " << leftFenseROI.xMax << 
 	//         "  zMin_  " << leftFenseROI.zMin << "  zMax_  " << leftFenseROI.zMax << endl;
 
-	//-- Change the color of the extracted part for debuging
-	for (int i = 0; i < inliers->indices.size(); i++)
+	//-- Label the extracted part for debuging
+	debugView.paint(inliers->indices, DEBUG_LABEL_FENSE);
+
+	duneROI = duneROIOf(leftFenseROI);
+
+	//-- Refit if the fense moved too far for the speculative fit
+	group.wait();
+
+	if (!roiClose(duneROI, speculativeROI, params.speculativeTolerance))
 	{
-		dstCloud->points[inliers->indices[i]].r = 234;
-		dstCloud->points[inliers->indices[i]].g = 67;
-		dstCloud->points[inliers->indices[i]].b = 53;
+		duneFound = extractPlaneWithinROI(verticalCloud, duneROI, duneInliers, duneCoefficients);
 	}
+	inliers = duneInliers;
+	coefficients = duneCoefficients;
 
-	duneROI.xMin = leftFenseROI.xMax - 0.3;
-	duneROI.xMax = leftFenseROI.xMax + 0.9;
-	duneROI.zMin = leftFenseROI.zMax - 0.3;
-	duneROI.zMax = leftFenseROI.zMax + 0.9;
+	if (!duneFound)
+	{
+		//-- Left fense is still worth publishing
+		voteForNextStage(false);
 
+		result.detected = false;
+		result.xDistance = xDistance;
+		result.angle = plus_minus * acos(angleCosine) / PI * 180;
 
-	extractPlaneWithinROI(verticalCloud, duneROI, inliers, coefficients);
-	//-- Change the color of the extracted part for debuging
-	for (int i = 0; i < inliers->indices.size(); i++)
-	{
-		dstCloud->points[inliers->indices[i]].r = 251;
-		dstCloud->points[inliers->indices[i]].g = 188;
-		dstCloud->points[inliers->indices[i]].b = 5;
+		updateViewer();
+		return;
 	}
 
+	//-- Label the extracted part for debuging
+	debugView.paint(inliers->indices, DEBUG_LABEL_DUNE);
+
 
 
 	//-- The formula of dune is ax + by + cz + d = 0, which x = 0.0 and y = cameraHeight - 0.05
@@ -616,44 +1495,43 @@ void RobotLocator::locateBeforeDuneStage2(void)
 
 	double duneDistance = (coefficients->values[1] * (cameraHeight - 0.05) + coefficients->values[3]) / vecNormal.norm();
 
-	if (zDistance < 1.40f) { nextStatusCounter++; }
-	else { nextStatusCounter = 0; }
+	voteForNextStage(zDistance < 1.40f);
 
-	if (nextStatusCounter >= 3) { status++; }
+	result.duneDistance = duneDistance;
+	result.zDistance = zDistance;
+	result.xDistance = xDistance;
+	result.angle = plus_minus * acos(angleCosine) / PI * 180;
 
-	cout << "duneDistance  " << duneDistance << "Z distance  " << zDistance << " " << "leftX distance  " << xDistance << " " << "angle  " << plus_minus * acos(angleCosine) / PI * 180 << endl;
+	if (interactive) { cout << "duneDistance  " << duneDistance << "Z distance  " << zDistance << " " << "leftX distance  " << xDistance << " " << "angle  " << plus_minus * acos(angleCosine) / PI * 180 << endl; }
 
-	dstViewer->updatePointCloud(dstCloud, "Destination Cloud");
-	dstViewer->spinOnce(1);
+	updateViewer();
 	//cout <<"Z distance  " << zDistance<<" "<<angleCosine<<" "<< double(totalTime.count()) / 1000.0f <<" "<<  double(totalTime1.count()) / 1000.0f <<" " <<double(totalTime2.count()) / 1000.0f <<" "<<double(totalTime3.count()) / 1000.0f<<" "<<double(totalTime4.count()) / 1000.0f 
 	//<<" "<< double(totalTimeall.count()) / 1000.0f<< endl;
 }
 
-void RobotLocator::locateBeforeDuneStage3(void)
+template <typename PointT, template <typename> class DebugPolicy>
+void RobotLocatorT<PointT, DebugPolicy>::locateBeforeDuneStage3(void)
 {
-	extractVerticalCloud(filteredCloud);
-
 	//-- Perform the plane segmentation with specific indices
 	pcl::PointIndices::Ptr inliers(new pcl::PointIndices);
 	pcl::ModelCoefficients::Ptr coefficients(new pcl::ModelCoefficients);
 
-	extractPlaneWithinROI(verticalCloud, duneROI, inliers, coefficients);
-	duneROI = updateObjectROI(verticalCloud, inliers, 0.1, 0.1, 0.3, 0.3);
-
-	//-- Change the color of the extracted part for debuging
-	for (int i = 0; i < inliers->indices.size(); i++)
+	if (!extractPlaneWithinROI(verticalCloud, duneROI, inliers, coefficients))
 	{
-		dstCloud->points[inliers->indices[i]].r = 251;
-		dstCloud->points[inliers->indices[i]].g = 188;
-		dstCloud->points[inliers->indices[i]].b = 5;
+		result.detected = false;
+		updateViewer();
+		return;
 	}
+	duneROI = updateObjectROI(verticalCloud, inliers, 0.1, 0.1, 0.3, 0.3);
+
+	//-- Label the extracted part for debuging
+	debugView.paint(inliers->indices, DEBUG_LABEL_DUNE);
 
 	//-- Calculate the vertical distance to dune
-	Vector3d vecNormal(groundCoeffRotated->values[0], groundCoeffRotated->values[1], groundCoeffRotated->values[2]);
-	double cameraHeight = abs(groundCoeffRotated->values[3]) / vecNormal.norm();
+	double cameraHeight = ground.cameraHeight;
 
 	//-- The formula of dune is ax + by + cz + d = 0, which y = cameraHeight - 0.05
-	vecNormal = Vector3d(coefficients->values[0], coefficients->values[1], coefficients->values[2]);
+	Vector3d vecNormal(coefficients->values[0], coefficients->values[1], coefficients->values[2]);
 	double duneDistance = (coefficients->values[1] * (cameraHeight - 0.05) + coefficients->values[3]) / vecNormal.norm();
 
 	Vector2d normalleft2d(coefficients->values[0], coefficients->values[2]);
@@ -670,39 +1548,31 @@ void RobotLocator::locateBeforeDuneStage3(void)
 
 	// if (nextStatusCounter >= 3) { status++; }
 
-	cout << "Dune distance  " << duneDistance << " z_anxis " << plus_minus * acos(angleCosine) / PI * 180 - 45 << " anxis " << angleCosine << endl;
+	result.duneDistance = duneDistance;
+	result.angle = plus_minus * acos(angleCosine) / PI * 180 - 45;
+
+	if (interactive) { cout << "Dune distance  " << duneDistance << " z_anxis " << plus_minus * acos(angleCosine) / PI * 180 - 45 << " anxis " << angleCosine << endl; }
 
-	dstViewer->updatePointCloud(dstCloud, "Destination Cloud");
-	dstViewer->spinOnce(1);
+	updateViewer();
 }
 
-void RobotLocator::locatePassingDune(void)
+template <typename PointT, template <typename> class DebugPolicy>
+void RobotLocatorT<PointT, DebugPolicy>::locatePassingDune(void)
 {
-	extractVerticalCloud(filteredCloud);
-
-	//-- Get point cloud indices inside given ROI
-	pcl::PassThrough<pointType> pass;
-	pass.setInputCloud(verticalCloud);
-	pass.setFilterFieldName("x");
-	pass.setFilterLimits(frontFenseROI.xMin, 0.0);
-	pass.filter(indicesROI->indices);
-
-	pass.setInputCloud(verticalCloud);
-	pass.setFilterFieldName("z");
-	pass.setFilterLimits(frontFenseROI.zMin, frontFenseROI.zMax);
-	pass.setIndices(indicesROI);
-	pass.filter(indicesROI->indices);
+	//-- Get point cloud indices inside given ROI, left of the camera
+	ObjectROI leftROI = { frontFenseROI.xMin, 0.0, frontFenseROI.zMin, frontFenseROI.zMax };
+	indicesWithinROI(verticalCloud, leftROI, indicesROI->indices);
 
 	// Creating the KdTree object for the search method of the extraction
-	pcl::search::KdTree<pointType>::Ptr tree(new pcl::search::KdTree<pointType>);
+	typename pcl::search::KdTree<PointT>::Ptr tree(new pcl::search::KdTree<PointT>);
 	tree->setInputCloud(verticalCloud);
 
 	std::vector<pcl::PointIndices> clusterIndices;
 	pcl::PointIndices::Ptr largestIndice(new pcl::PointIndices);
 
 	//-- Perform euclidean cluster extraction
-	pcl::EuclideanClusterExtraction<pointType> ec;
-	ec.setClusterTolerance(0.1);
+	pcl::EuclideanClusterExtraction<PointT> ec;
+	ec.setClusterTolerance(params.clusterTolerance);
 	ec.setMinClusterSize(100);
 	ec.setMaxClusterSize(25000);
 	ec.setSearchMethod(tree);
@@ -718,15 +1588,17 @@ void RobotLocator::locatePassingDune(void)
 		}
 	}
 
+	if (largestIndice->indices.empty())
+	{
+		result.detected = false;
+		updateViewer();
+		return;
+	}
+
 	frontFenseROI = updateObjectROI(verticalCloud, largestIndice, 0.3, 0.0, 0.1, 0.1);
 
-	//-- Change the color of the extracted part for debuging
-	//for (int i = 0; i < largestIndice->indices.size(); i++)
-	//{
-	//    dstCloud->points[largestIndice->indices[i]].r = 251;
-	//    dstCloud->points[largestIndice->indices[i]].g = 188;
-	 //   dstCloud->points[largestIndice->indices[i]].b = 5;
-   // }
+	//-- Label the extracted part for debuging
+	//debugView.paint(largestIndice->indices, DEBUG_LABEL_CLUSTER);
 
 	Eigen::Vector4f minVector, maxVector;
 	pcl::getMinMax3D(*verticalCloud, *largestIndice, minVector, maxVector);
@@ -739,30 +1611,30 @@ void RobotLocator::locatePassingDune(void)
 
 	// // if (nextStatusCounter >= 3) { status++; }
 
-	cout << "front fense distance  " << fenseDistance << endl;
+	result.fenseDistance = fenseDistance;
+
+	if (interactive) { cout << "front fense distance  " << fenseDistance << endl; }
 
-	dstViewer->updatePointCloud(dstCloud, "Destination Cloud");
-	dstViewer->spinOnce(1);
+	updateViewer();
 }
 
-void RobotLocator::locateBeforeGrasslandStage1(void)
+template <typename PointT, template <typename> class DebugPolicy>
+void RobotLocatorT<PointT, DebugPolicy>::locateBeforeGrasslandStage1(void)
 {
-	extractVerticalCloud(filteredCloud);
-
 	//-- Perform the plane segmentation with specific indices
 	pcl::PointIndices::Ptr inliers(new pcl::PointIndices);
 	pcl::ModelCoefficients::Ptr coefficients(new pcl::ModelCoefficients);
 
-	extractPlaneWithinROI(verticalCloud, frontFenseROI, inliers, coefficients);
+	if (!extractPlaneWithinROI(verticalCloud, frontFenseROI, inliers, coefficients))
+	{
+		result.detected = false;
+		updateViewer();
+		return;
+	}
 	frontFenseROI = updateObjectROI(verticalCloud, inliers, 0.1, 0.1, 0.3, 0.3);
 
-	//-- Change the color of the extracted part for debuging
-	//for (int i = 0; i < inliers->indices.size(); i++)
-	//{
-	 //   dstCloud->points[inliers->indices[i]].r = 251;
-	 //   dstCloud->points[inliers->indices[i]].g = 188;
-	 //   dstCloud->points[inliers->indices[i]].b = 5;
-   // }
+	//-- Label the extracted part for debuging
+	//debugView.paint(inliers->indices, DEBUG_LABEL_CLUSTER);
 
 	Eigen::Vector4f minVector, maxVector;
 	pcl::getMinMax3D(*verticalCloud, *inliers, minVector, maxVector);
@@ -776,23 +1648,26 @@ void RobotLocator::locateBeforeGrasslandStage1(void)
 
 	// if (nextStatusCounter >= 3) { status++; }
 
-	cout << "front fense distance  " << fenseDistance << "  x_" << fenseCornerX << endl;
+	result.fenseDistance = fenseDistance;
+	result.xDistance = fenseCornerX;
 
-	dstViewer->updatePointCloud(dstCloud, "Destination Cloud");
-	dstViewer->spinOnce(1);
+	if (interactive) { cout << "front fense distance  " << fenseDistance << "  x_" << fenseCornerX << endl; }
+
+	updateViewer();
 }
 
-void RobotLocator::locateBeforeGrasslandStage2(void)
+template <typename PointT, template <typename> class DebugPolicy>
+void RobotLocatorT<PointT, DebugPolicy>::locateBeforeGrasslandStage2(void)
 {
-	extractVerticalCloud(filteredCloud);
-
-
-
-	dstViewer->updatePointCloud(dstCloud, "Destination Cloud");
-	dstViewer->spinOnce(1);
+	//-- Only the ground is tracked here, the viewer thread keeps its window responsive
 }
 
-bool RobotLocator::isStoped(void)
+template <typename PointT, template <typename> class DebugPolicy>
+bool RobotLocatorT<PointT, DebugPolicy>::isStoped(void)
 {
-	return dstViewer->wasStopped();
-}
\ No newline at end of file
+	return debugView.wasStopped();
+}
+
+//-- The locators the executables and tools are built with
+template class RobotLocatorT<pcl::PointXYZRGB, DebugView>;
+template class RobotLocatorT<pcl::PointXYZ, NoDebugView>;
@@ -12,9 +12,31 @@
 #define BEFORE_GRASSLAND_STAGE_2   6
 #define PASSING_GRASSLAND          7
 
+//-- Per-frame features a locate stage can depend on, computed lazily
+#define FEATURE_NONE               0x00
+#define FEATURE_FILTERED_CLOUD     0x01
+#define FEATURE_GROUND_PLANE       0x02
+#define FEATURE_VERTICAL_CLOUD     0x04
+#define FEATURE_VERTICAL_NORMALS   0x08
+#define FEATURE_PLANE_MAP          0x10
+#define FEATURE_HORIZONTAL_NORMALS 0x20
+
+//-- ROIs a locate stage crops to, the next frame is only deprojected around them
+#define STAGE_ROI_NONE             0x00
+#define STAGE_ROI_LEFT_FENSE       0x01
+#define STAGE_ROI_DUNE             0x02
+#define STAGE_ROI_FRONT_FENSE      0x04
+
+//-- How removeHorizontalPlane tells horizontal points apart
+#define HORIZONTAL_REMOVAL_NORMALS       0   /* normal of every point against the ground normal */
+#define HORIZONTAL_REMOVAL_HEIGHT_BANDS  1   /* height spread per grid cell, normals for mixed cells only */
+
 #define PI                         3.1415926
 #define STD_ROI {-0.6f, 0.6f, 0.0f, 2.5f}
 
+//-- Pass through limits of filterCloud, in the frame of each camera
+#define PASS_ROI {-1.0f, 1.0f, 0.0f, 4.0f}
+
 #include <pcl/point_types.h>
 #include <pcl/common/common.h>
 #include <pcl/common/transforms.h>
@@ -34,8 +56,21 @@
 #include <pcl/filters/radius_outlier_removal.h>
 #include <Eigen/Dense>
 #include <cmath>
-#include "act_d435.h"
+#include <iostream>
+#include <memory>
+#include "frame_source.h"
+#include "camera_rig.h"
+#include "debug_view.h"
+#include "ground_calibration.h"
+#include "ground_estimator.h"
+#include "parallel_filter.h"
+#include "plane_segmenter.h"
+#include "quality_scheduler.h"
+#include "task_pool.h"
+#include "locator_params.h"
+#include "morton_order.h"
 
+using namespace std;
 using namespace Eigen;
 
 //-- ROI of an object
@@ -49,35 +84,73 @@ typedef struct
 
 } ObjectROI;
 
-//-- Algorithm implementation for robot locating
-class RobotLocator
+//-- Distances and angle published by the last locate stage, NAN if not measured
+typedef struct
+{
+	unsigned int status;
+	double timestamp;
+	unsigned long long number;
+
+	bool detected;   /* false if a stage target was not found */
+
+	double xDistance;
+	double zDistance;
+	double duneDistance;
+	double fenseDistance;
+	double angle;
+
+	double latency;  /* milliseconds from frame arrival to the result */
+	int quality;     /* level of the quality scheduler, 0 is full quality */
+	bool reused;     /* the scene stood still, the values are those of the last processed frame */
+
+} LocateResult;
+
+//-- Algorithm implementation for robot locating, instantiated in robot_locator.cpp for the locators below
+template <typename PointT, template <typename> class DebugPolicy>
+class RobotLocatorT
 {
 public:
-	RobotLocator();
-	RobotLocator(const RobotLocator&) = delete;
-	RobotLocator& operator=(const RobotLocator&) = delete;
-	~RobotLocator();
+	typedef pcl::PointCloud<PointT>  Cloud;
+	typedef typename Cloud::Ptr      CloudPtr;
+
+	RobotLocatorT(bool interactive = true);
+	RobotLocatorT(const RobotLocatorT&) = delete;
+	RobotLocatorT& operator=(const RobotLocatorT&) = delete;
+	~RobotLocatorT();
 
-	void init(ActD435& d435);
+	//-- False if the sources ran dry or no frame showed the ground before a fit
+	bool init(FrameSource& source);
+	bool init(const CameraMounts& mounts);
 
-	pPointCloud updateCloud(void);
+	//-- File of the ground calibration, checked on init and rewritten after a full calibration, none if empty
+	inline void setCalibrationPath(const string& path) { calibrationPath = path; }
+
+	bool updateCloud(void);
 
 	void preProcess(void);
 
-	void extractPlaneWithinROI(pPointCloud cloud, ObjectROI roi,
+	bool extractPlaneWithinROI(CloudPtr cloud, ObjectROI roi,
 		pcl::PointIndices::Ptr indices, pcl::ModelCoefficients::Ptr coefficients);
 
-	pcl::ModelCoefficients::Ptr extractGroundCoeff(pPointCloud cloud);
+	//-- Largest segment of the plane map inside the ROI, optionally with its normal near an axis
+	bool selectPlaneSegment(ObjectROI roi, pcl::PointIndices::Ptr indices, pcl::ModelCoefficients::Ptr coefficients,
+		Vector3d axis = Vector3d::Zero(), double minCosine = 0.0);
+
+	pcl::ModelCoefficients::Ptr extractGroundCoeff(CloudPtr cloud);
 
-	pPointCloud rotatePointCloudToHorizontal(pPointCloud cloud);
+	CloudPtr rotatePointCloudToHorizontal(CloudPtr cloud);
 
-	pPointCloud removeHorizontalPlane(pPointCloud cloud, bool onlyGround = false);
+	CloudPtr removeHorizontalPlane(CloudPtr cloud, bool onlyGround = false);
 
-	pPointCloud extractVerticalCloud(pPointCloud cloud);
+	void requireFeatures(unsigned int features);
 
-	ObjectROI updateObjectROI(pPointCloud cloud, pcl::PointIndices::Ptr indices,
+	void locate(void);
+
+	ObjectROI updateObjectROI(CloudPtr cloud, pcl::PointIndices::Ptr indices,
 		double xMinus, double xPlus, double zMinus, double zPlus);
 
+	void locateStartupInitial(void);
+
 	void locateBeforeDuneStage1(void);
 	void locateBeforeDuneStage2(void);
 	void locateBeforeDuneStage3(void);
@@ -89,24 +162,127 @@ public:
 
 	bool isStoped(void);
 
-	inline pPointCloud getSrcCloud(void) { return srcCloud; }
-	inline pPointCloud getFilteredCloud(void) { return filteredCloud; }
+	inline CloudPtr getSrcCloud(void) { return srcCloud; }
+	inline CloudPtr getFilteredCloud(void) { return filteredCloud; }
+	inline CloudPtr getVerticalCloud(void) { return verticalCloud; }
+
+	inline const LocateResult& getResult(void) { return result; }
+	inline const ObjectROI& getLeftFenseROI(void) { return leftFenseROI; }
+	inline const ObjectROI& getDuneROI(void) { return duneROI; }
+	inline const ObjectROI& getFrontFenseROI(void) { return frontFenseROI; }
+
+	//-- Whether init reused the saved ground calibration, and how long it took in milliseconds
+	inline bool isWarmStarted(void) { return warmStarted; }
+	inline double getStartupTime(void) { return startupTime; }
+
+private:
+	bool grabCloud(bool filter = false);
+
+	//-- Grabs and decimates the frame of a camera and measures its change, processCamera deprojects it
+	bool grabCamera(size_t index);
+	void processCamera(size_t index, bool filter);
+
+	//-- Whether the frames just grabbed show the scene of the last processed ones
+	bool isStaticFrame(void);
+
+	void filterCloud(CloudPtr cloud, CloudPtr filtered);
+
+	//-- Sorts the cloud along the Z-order curve on cells of the voxel leaf, in place
+	void mortonSort(CloudPtr cloud);
+
+	//-- False if no frame gave a ground fit
+	bool calibrateGround(void);
+	bool checkGroundCalibration(const GroundCalibration& calibration);
+	GroundCalibration currentCalibration(void);
+
+	//-- Near and down sampled points the ground fits run on, in place
+	void groundCandidates(CloudPtr cloud);
+
+	//-- Share of the points within the RANSAC threshold of the plane
+	double groundShare(CloudPtr cloud, const float* plane);
+
+	void indicesWithinROI(CloudPtr cloud, ObjectROI roi, vector<int>& indices);
+
+	//-- Depth windows of the ROIs in roiMask for the next frame, none if the stage crops nothing
+	void updateDepthWindows(unsigned int roiMask);
+
+	//-- Takes the ground of this frame, from the background estimator if it runs or from a fit on the cloud
+	void updateGround(void);
+
+	//-- Rotation about the x-axis that levels the ground plane of this frame
+	Eigen::Affine3f horizontalRotation(void);
+
+	//-- Normals of the indexed points only if indices is not NULL, searched on the whole cloud
+	pcl::PointCloud<pcl::Normal>::Ptr estimateNormals(CloudPtr cloud, double radius, const vector<int>* indices = NULL);
+
+	//-- Points of removeHorizontalPlane to keep, by the height spread of their grid cell
+	void selectByHeight(CloudPtr cloud, bool onlyGround, const float plane[4], vector<int>& vertical);
+
+	void voteForNextStage(bool condition);
+
+	void updateViewer(void);
+
+	//-- Arrival of the oldest frame of the current set
+	double frameArrival(void);
 
 public:
 	unsigned int status;
 	unsigned int nextStatusCounter;
 
+	LocatorParams params;
+
 private:
-	ActD435*        thisD435;
+	bool            interactive;
+
+	//-- Per camera, the first one is the reference frame and feeds srcCloud
+	CameraMounts        cameras;
+	vector<DepthFrame>  depthFrames;
+	vector<CloudPtr>    cameraClouds;
+	vector<CloudPtr>    cameraFiltered;
 
-	pPointCloud		srcCloud;
-	pPointCloud     filteredCloud;
-	pPointCloud     verticalCloud;
-	pPointCloud     dstCloud;
+	//-- Pixels of the first camera the next frame deprojects, all of them if empty
+	DepthWindows        depthWindows;
+
+	//-- Decimated depth of the last processed frame per camera, and the change of the current frame against it
+	vector<vector<uint16_t> > staticDepth;
+	vector<double>      depthChange;
+	bool                staticFrame;     /* the current frame reuses everything of the last processed one */
+	int                 reusedFrames;    /* in a row */
+	bool                located;         /* a result to reuse exists */
+	int                 lastVote;        /* condition of the last vote of the stage, -1 if it did not vote */
+
+	LocateResult    result;
+
+	unique_ptr<TaskPool> taskPool;
+
+	//-- Parameters as set before init, the scheduler derives the ones in use from them
+	LocatorParams    baseParams;
+	QualityScheduler scheduler;
+
+	CloudPtr        srcCloud;
+	CloudPtr        groundSample;     /* sparse full frame of the first camera, only while groundSampled */
+	bool            groundSampled;    /* srcCloud is culled to the ROIs, the ground is fitted on groundSample */
+	CloudPtr        filteredCloud;
+	CloudPtr        verticalCloud;
+
+	pcl::PointCloud<pcl::Normal>::Ptr horizontalNormals;
+	pcl::PointCloud<pcl::Normal>::Ptr verticalNormals;
+	PlaneSegments   planeSegments;
+
+	unsigned int    readyFeatures;
+
+	string          calibrationPath;
+	bool            warmStarted;
+	double          startupTime;
+	double          groundInlierShare;
 
 	pcl::ModelCoefficients::Ptr groundCoeff;
 	pcl::ModelCoefficients::Ptr groundCoeffRotated;
 
+	//-- Ground of the current frame, and the low rate refits which provide it unless groundRate is 0
+	GroundSnapshot          ground;
+	GroundEstimator<PointT> groundEstimator;
+
 	pcl::PointIndices::Ptr  indicesROI;
 	ObjectROI               leftFenseROI;
 	ObjectROI               duneROI;
@@ -115,7 +291,20 @@ private:
 	float leftFenseDist;
 	float duneDist;
 
-	pcl::visualization::PCLVisualizer::Ptr dstViewer;
+	DebugPolicy<PointT> debugView;
 };
 
+//-- Debug pipeline, colored clouds shown in the viewer
+typedef RobotLocatorT<pcl::PointXYZRGB, DebugView> DebugRobotLocator;
+
+//-- Production pipeline, XYZ points and no debug work at all
+typedef RobotLocatorT<pcl::PointXYZ, NoDebugView> FieldRobotLocator;
+
+//-- LOCATOR_DEBUG_VIEW picks the one the executables run
+#ifdef LOCATOR_DEBUG_VIEW
+typedef DebugRobotLocator RobotLocator;
+#else
+typedef FieldRobotLocator RobotLocator;
+#endif
+
 #endif
@@ -0,0 +1,144 @@
+#include "rvl_codec.h"
+#include <cstring>
+
+namespace
+{
+	//-- Packs nibbles from the high end of 32 bit words
+	class NibbleWriter
+	{
+	public:
+		NibbleWriter(std::vector<uint32_t>& words) : words(words), word(0), nibbles(0) {}
+
+		void encode(uint32_t value)
+		{
+			do
+			{
+				uint32_t nibble = value & 0x7;
+				value >>= 3;
+				if (value) { nibble |= 0x8; }
+
+				word = (word << 4) | nibble;
+				if (++nibbles == 8)
+				{
+					words.push_back(word);
+					word = 0;
+					nibbles = 0;
+				}
+			} while (value);
+		}
+
+		void flush(void)
+		{
+			if (nibbles) { words.push_back(word << (4 * (8 - nibbles))); }
+			word = 0;
+			nibbles = 0;
+		}
+
+	private:
+		std::vector<uint32_t>& words;
+		uint32_t word;
+		int      nibbles;
+	};
+
+	class NibbleReader
+	{
+	public:
+		NibbleReader(const uint8_t* data, size_t size) : data(data), wordNum(size / 4), next(0), word(0), nibbles(0) {}
+
+		bool decode(uint32_t& value)
+		{
+			value = 0;
+
+			for (int shift = 0; shift < 32; shift += 3)
+			{
+				if (nibbles == 0)
+				{
+					if (next >= wordNum) { return false; }
+					memcpy(&word, data + next * 4, 4);
+					next++;
+					nibbles = 8;
+				}
+
+				uint32_t nibble = word >> 28;
+				word <<= 4;
+				nibbles--;
+
+				value |= (nibble & 0x7) << shift;
+				if (!(nibble & 0x8)) { return true; }
+			}
+
+			return false;
+		}
+
+	private:
+		const uint8_t* data;
+		size_t   wordNum;
+		size_t   next;
+		uint32_t word;
+		int      nibbles;
+	};
+}
+
+void rvlCompress(const uint16_t* depth, size_t pixelNum, std::vector<uint8_t>& encoded)
+{
+	std::vector<uint32_t> words;
+	words.reserve(pixelNum / 4 + 16);
+
+	NibbleWriter writer(words);
+	const uint16_t* end = depth + pixelNum;
+	int previous = 0;
+
+	while (depth != end)
+	{
+		uint32_t zeros = 0;
+		while (depth != end && *depth == 0) { depth++; zeros++; }
+		writer.encode(zeros);
+
+		uint32_t valid = 0;
+		for (const uint16_t* p = depth; p != end && *p != 0; p++) { valid++; }
+		writer.encode(valid);
+
+		for (uint32_t i = 0; i < valid; i++)
+		{
+			int current = *depth++;
+			int delta = current - previous;
+			writer.encode((uint32_t(delta) << 1) ^ uint32_t(delta >> 31));
+			previous = current;
+		}
+	}
+
+	writer.flush();
+
+	encoded.resize(words.size() * 4);
+	if (!words.empty()) { memcpy(encoded.data(), words.data(), encoded.size()); }
+}
+
+bool rvlDecompress(const uint8_t* encoded, size_t size, uint16_t* depth, size_t pixelNum)
+{
+	NibbleReader reader(encoded, size);
+	size_t filled = 0;
+	int previous = 0;
+
+	while (filled < pixelNum)
+	{
+		uint32_t zeros, valid;
+		if (!reader.decode(zeros) || zeros > pixelNum - filled) { return false; }
+
+		memset(depth + filled, 0, zeros * sizeof(uint16_t));
+		filled += zeros;
+
+		if (!reader.decode(valid) || valid > pixelNum - filled) { return false; }
+
+		for (uint32_t i = 0; i < valid; i++)
+		{
+			uint32_t positive;
+			if (!reader.decode(positive)) { return false; }
+
+			int delta = int(positive >> 1) ^ -int(positive & 1);
+			previous += delta;
+			depth[filled++] = uint16_t(previous);
+		}
+	}
+
+	return true;
+}
@@ -0,0 +1,20 @@
+#define _CRT_SECURE_NO_WARNINGS
+
+#ifndef RVL_CODEC_H_
+#define RVL_CODEC_H_
+
+#include <vector>
+#include <cstddef>
+#include <stdint.h>
+
+//-- Lossless run length / variable length coding of Z16 depth images (RVL, A. D. Wilson 2017)
+//-- Runs of invalid zeros and valid pixels alternate, valid pixels are stored as zigzag deltas to the previous valid one,
+//-- every count and delta goes as 3 bit nibble groups packed into 32 bit words
+
+//-- Replaces the content of encoded
+void rvlCompress(const uint16_t* depth, size_t pixelNum, std::vector<uint8_t>& encoded);
+
+//-- Return false if the data is truncated or holds more than pixelNum pixels
+bool rvlDecompress(const uint8_t* encoded, size_t size, uint16_t* depth, size_t pixelNum);
+
+#endif
@@ -0,0 +1,160 @@
+#include "task_pool.h"
+#include "thread_profile.h"
+#include <algorithm>
+
+//-- Worker identity of the current thread, -1 outside of any pool
+static thread_local const TaskPool* currentPool = NULL;
+static thread_local int currentIndex = -1;
+
+TaskGroup::TaskGroup(TaskPool& pool) : pool(pool), pending(0)
+{
+
+}
+
+TaskGroup::~TaskGroup()
+{
+	//-- Tasks may reference locals of the scope the group lives in
+	wait();
+}
+
+void TaskGroup::run(std::function<void()> task)
+{
+	if (pool.workers.empty())
+	{
+		task();
+		return;
+	}
+
+	pending++;
+
+	TaskPool::Task entry = { task, this };
+	pool.submit(entry);
+}
+
+void TaskGroup::wait(void)
+{
+	//-- Spinning here would take a core from the workers, they may be running the rest at a lower priority
+	while (pending > 0)
+	{
+		if (pool.runOne()) { continue; }
+
+		std::unique_lock<std::mutex> guard(doneLock);
+		done.wait(guard, [this]() { return pending == 0; });
+	}
+
+	//-- The thread that ran the last task may still be notifying, the group must outlive that
+	std::lock_guard<std::mutex> guard(doneLock);
+}
+
+TaskPool::TaskPool(unsigned int threadNum, const std::string& name) : name(name), queued(0), stopping(false), nextQueue(0)
+{
+	if (threadNum == 0) { threadNum = std::max(1u, std::thread::hardware_concurrency()); }
+
+	for (unsigned int i = 0; i + 1 < threadNum; i++)
+	{
+		queues.push_back(std::unique_ptr<WorkQueue>(new WorkQueue));
+	}
+
+	for (unsigned int i = 0; i + 1 < threadNum; i++)
+	{
+		workers.push_back(std::thread(&TaskPool::workerLoop, this, int(i)));
+	}
+}
+
+TaskPool::~TaskPool()
+{
+	{
+		std::lock_guard<std::mutex> guard(sleepLock);
+		stopping = true;
+	}
+	wakeUp.notify_all();
+
+	for (size_t i = 0; i < workers.size(); i++) { workers[i].join(); }
+}
+
+int TaskPool::selfIndex(void) const
+{
+	return (currentPool == this) ? currentIndex : -1;
+}
+
+void TaskPool::submit(const Task& task)
+{
+	//-- Workers keep what they spawn, other threads spread their tasks round robin
+	int self = selfIndex();
+	size_t index = (self >= 0) ? size_t(self) : nextQueue++ % queues.size();
+
+	{
+		std::lock_guard<std::mutex> guard(queues[index]->lock);
+		queues[index]->tasks.push_back(task);
+	}
+
+	{
+		std::lock_guard<std::mutex> guard(sleepLock);
+		queued++;
+	}
+	wakeUp.notify_one();
+}
+
+bool TaskPool::runOne(void)
+{
+	int self = selfIndex();
+	Task task;
+	bool found = false;
+
+	//-- Newest task of the own queue first, it is the most likely to be cache hot
+	if (self >= 0)
+	{
+		std::lock_guard<std::mutex> guard(queues[self]->lock);
+
+		if (!queues[self]->tasks.empty())
+		{
+			task = queues[self]->tasks.back();
+			queues[self]->tasks.pop_back();
+			found = true;
+		}
+	}
+
+	//-- Otherwise steal the oldest task of another queue
+	for (size_t i = 1; i <= queues.size() && !found; i++)
+	{
+		size_t victim = (size_t(self + queues.size()) + i) % queues.size();
+		std::lock_guard<std::mutex> guard(queues[victim]->lock);
+
+		if (!queues[victim]->tasks.empty())
+		{
+			task = queues[victim]->tasks.front();
+			queues[victim]->tasks.pop_front();
+			found = true;
+		}
+	}
+
+	if (!found) { return false; }
+
+	queued--;
+	task.task();
+
+	{
+		std::lock_guard<std::mutex> guard(task.group->doneLock);
+		if (--task.group->pending == 0) { task.group->done.notify_all(); }
+	}
+
+	return true;
+}
+
+void TaskPool::workerLoop(int index)
+{
+	ThreadRoleScope role(THREAD_ROLE_WORKER, name + "-" + std::to_string(index));
+
+	currentPool = this;
+	currentIndex = index;
+
+	while (true)
+	{
+		if (runOne()) { continue; }
+
+		std::unique_lock<std::mutex> guard(sleepLock);
+		wakeUp.wait(guard, [this]() { return stopping || queued > 0; });
+
+		if (stopping) { break; }
+	}
+}
@@ -0,0 +1,90 @@
+#define _CRT_SECURE_NO_WARNINGS
+
+#ifndef TASK_POOL_H_
+#define TASK_POOL_H_
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+class TaskPool;
+
+//-- Tasks waited for together, a waiting thread runs queued tasks and sleeps once none are left
+class TaskGroup
+{
+public:
+	explicit TaskGroup(TaskPool& pool);
+	TaskGroup(const TaskGroup&) = delete;
+	TaskGroup& operator=(const TaskGroup&) = delete;
+	~TaskGroup();
+
+	void run(std::function<void()> task);
+	void wait(void);
+
+private:
+	TaskPool&        pool;
+	std::atomic<int> pending;
+
+	//-- Signalled when pending drops to 0, pending only drops while holding doneLock
+	std::mutex              doneLock;
+	std::condition_variable done;
+
+	friend class TaskPool;
+};
+
+//-- Fixed set of workers with one deque each, owners pop the newest task and idle workers steal the oldest
+class TaskPool
+{
+public:
+	//-- threadNum counts the waiting thread too, 0 takes every hardware thread, 1 runs every task inline
+	//-- Workers are named <name>-<n> and placed as THREAD_ROLE_WORKER by the thread profile
+	explicit TaskPool(unsigned int threadNum = 0, const std::string& name = "pool");
+	TaskPool(const TaskPool&) = delete;
+	TaskPool& operator=(const TaskPool&) = delete;
+	~TaskPool();
+
+	inline unsigned int size(void) const { return (unsigned int)(workers.size()) + 1; }
+
+private:
+	typedef struct
+	{
+		std::function<void()> task;
+		TaskGroup*            group;
+
+	} Task;
+
+	typedef struct
+	{
+		std::mutex       lock;
+		std::deque<Task> tasks;
+
+	} WorkQueue;
+
+	void submit(const Task& task);
+	bool runOne(void);
+	void workerLoop(int index);
+
+	int selfIndex(void) const;
+
+private:
+	std::vector<std::unique_ptr<WorkQueue> > queues;
+	std::vector<std::thread>                 workers;
+	std::string                              name;
+
+	std::mutex              sleepLock;
+	std::condition_variable wakeUp;
+
+	std::atomic<int>          queued;
+	std::atomic<bool>         stopping;
+	std::atomic<unsigned int> nextQueue;
+
+	friend class TaskGroup;
+};
+
+#endif
@@ -0,0 +1,251 @@
+#include "thread_profile.h"
+#include <atomic>
+#include <iostream>
+#include <mutex>
+
+#ifdef __linux__
+#include <cstring>
+#include <pthread.h>
+#include <sched.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+#endif
+
+//-- Linux numbers the second hardware thread of core n as CPU n + 4 on the NUC8i7HVK (4 cores, 8 threads)
+#define NUC_CORE_0    0x11ull   /* CPUs 0 and 4 */
+#define NUC_CORES_1_3 0xEEull   /* CPUs 1-3 and 5-7 */
+
+static const ThreadProfile threadProfiles[] =
+{
+	//-- Everything where the scheduler puts it, parameters as set
+	{ "default", { { 0, 0 }, { 0, 0 }, { 0, 0 }, { 0, 0 } }, 0, 0 },
+
+	//-- Capture and the background threads on core 0, the frame and its workers on cores 1-3,
+	//-- OpenMP capped so that the normals do not crowd out the task pool
+	{ "nuc", { { NUC_CORE_0, 0 }, { NUC_CORES_1_3, 0 }, { NUC_CORES_1_3, 0 }, { NUC_CORE_0, 0 } }, 6, 2 },
+
+	//-- Same with SCHED_FIFO, capture above the frame so no frame is lost while it runs, needs an rtprio limit
+	{ "nuc-rt", { { NUC_CORE_0, 30 }, { NUC_CORES_1_3, 20 }, { NUC_CORES_1_3, 20 }, { NUC_CORE_0, 0 } }, 6, 2 }
+};
+
+static ThreadProfile activeProfile = threadProfiles[0];
+
+const ThreadProfile* findThreadProfile(const std::string& name)
+{
+	for (size_t i = 0; i < sizeof(threadProfiles) / sizeof(threadProfiles[0]); i++)
+	{
+		if (name == threadProfiles[i].name) { return &threadProfiles[i]; }
+	}
+
+	return NULL;
+}
+
+std::vector<std::string> threadProfileNames(void)
+{
+	std::vector<std::string> names;
+
+	for (size_t i = 0; i < sizeof(threadProfiles) / sizeof(threadProfiles[0]); i++)
+	{
+		names.push_back(threadProfiles[i].name);
+	}
+
+	return names;
+}
+
+void setThreadProfile(const ThreadProfile& profile)
+{
+	activeProfile = profile;
+}
+
+const ThreadProfile& getThreadProfile(void)
+{
+	return activeProfile;
+}
+
+#ifdef __linux__
+
+//-- Software counters of one thread, the context switch counter leads the group
+typedef struct
+{
+	pid_t    tid;
+	int      role;
+	int      leader;
+	int      migrations;
+
+	uint64_t baseSwitches;     /* counts of the roles the thread was in before */
+	uint64_t baseMigrations;
+
+} CountedThread;
+
+static std::mutex                 counterLock;
+static std::vector<CountedThread> countedThreads;
+static ThreadCounters             retiredCounts[THREAD_ROLE_NUM];
+static bool                       countersAvailable = false;
+static std::atomic<bool>          placementWarned(false);
+
+static int openCounter(uint64_t config, int group)
+{
+	struct perf_event_attr attr;
+	memset(&attr, 0, sizeof(attr));
+	attr.type = PERF_TYPE_SOFTWARE;
+	attr.size = sizeof(attr);
+	attr.config = config;
+	attr.read_format = PERF_FORMAT_GROUP;
+
+	//-- The calling thread on any CPU
+	return int(syscall(__NR_perf_event_open, &attr, 0, -1, group, 0));
+}
+
+//-- Adds the counts of the thread since it entered its current role
+static bool readCounted(const CountedThread& counted, ThreadCounters& counters)
+{
+	uint64_t values[3];   /* number of counters, switches, migrations */
+	if (read(counted.leader, values, sizeof(values)) != ssize_t(sizeof(values))) { return false; }
+
+	counters.contextSwitches += values[1] - counted.baseSwitches;
+	counters.migrations += values[2] - counted.baseMigrations;
+
+	return true;
+}
+
+bool enterThreadRole(int role, const std::string& name)
+{
+	const ThreadPlacement& placement = activeProfile.roles[role];
+	bool placed = true;
+
+	pthread_setname_np(pthread_self(), name.substr(0, 15).c_str());
+
+	if (placement.cpus != 0)
+	{
+		cpu_set_t cpus;
+		CPU_ZERO(&cpus);
+		for (int i = 0; i < 64 && i < CPU_SETSIZE; i++)
+		{
+			if (placement.cpus & (1ull << i)) { CPU_SET(i, &cpus); }
+		}
+
+		placed = (pthread_setaffinity_np(pthread_self(), sizeof(cpus), &cpus) == 0) && placed;
+	}
+
+	if (placement.priority > 0)
+	{
+		struct sched_param param;
+		param.sched_priority = placement.priority;
+
+		placed = (pthread_setschedparam(pthread_self(), SCHED_FIFO, &param) == 0) && placed;
+	}
+
+	if (!placed && !placementWarned.exchange(true))
+	{
+		std::cerr << "Thread profile " << activeProfile.name << " only partly applied, it needs the CPUs it names "
+			<< "and, for SCHED_FIFO, CAP_SYS_NICE or an rtprio limit" << std::endl;
+	}
+
+	//-- Counting is best effort, perf_event_paranoid may forbid it, a thread changing roles keeps its counters
+	CountedThread counted;
+	counted.tid = pid_t(syscall(SYS_gettid));
+	counted.role = role;
+	counted.baseSwitches = 0;
+	counted.baseMigrations = 0;
+
+	{
+		std::lock_guard<std::mutex> guard(counterLock);
+		for (size_t i = 0; i < countedThreads.size(); i++)
+		{
+			CountedThread& known = countedThreads[i];
+			if (known.tid != counted.tid) { continue; }
+
+			//-- The counts so far stay with the role they were made in
+			ThreadCounters& retired = retiredCounts[known.role];
+			uint64_t switches = retired.contextSwitches, migrations = retired.migrations;
+
+			if (readCounted(known, retired))
+			{
+				known.baseSwitches += retired.contextSwitches - switches;
+				known.baseMigrations += retired.migrations - migrations;
+			}
+			known.role = role;
+
+			return placed;
+		}
+	}
+
+	counted.leader = openCounter(PERF_COUNT_SW_CONTEXT_SWITCHES, -1);
+	counted.migrations = (counted.leader >= 0) ? openCounter(PERF_COUNT_SW_CPU_MIGRATIONS, counted.leader) : -1;
+
+	if (counted.leader >= 0 && counted.migrations >= 0)
+	{
+		std::lock_guard<std::mutex> guard(counterLock);
+		countedThreads.push_back(counted);
+		countersAvailable = true;
+	}
+	else if (counted.leader >= 0)
+	{
+		close(counted.leader);
+	}
+
+	return placed;
+}
+
+void leaveThreadRole(void)
+{
+	pid_t tid = pid_t(syscall(SYS_gettid));
+
+	std::lock_guard<std::mutex> guard(counterLock);
+
+	for (size_t i = 0; i < countedThreads.size(); i++)
+	{
+		if (countedThreads[i].tid != tid) { continue; }
+
+		readCounted(countedThreads[i], retiredCounts[countedThreads[i].role]);
+		close(countedThreads[i].migrations);
+		close(countedThreads[i].leader);
+
+		countedThreads.erase(countedThreads.begin() + i);
+		break;
+	}
+}
+
+ThreadCounters readThreadCounters(unsigned int roles)
+{
+	std::lock_guard<std::mutex> guard(counterLock);
+
+	ThreadCounters counters = { countersAvailable, 0, 0 };
+
+	for (int role = 0; role < THREAD_ROLE_NUM; role++)
+	{
+		if (!(roles & THREAD_ROLE_BIT(role))) { continue; }
+
+		counters.contextSwitches += retiredCounts[role].contextSwitches;
+		counters.migrations += retiredCounts[role].migrations;
+	}
+
+	for (size_t i = 0; i < countedThreads.size(); i++)
+	{
+		if (roles & THREAD_ROLE_BIT(countedThreads[i].role)) { readCounted(countedThreads[i], counters); }
+	}
+
+	return counters;
+}
+
+#else
+
+//-- Placement and counters are Linux only, elsewhere the profile is accepted and ignored
+bool enterThreadRole(int, const std::string&)
+{
+	return true;
+}
+
+void leaveThreadRole(void)
+{
+
+}
+
+ThreadCounters readThreadCounters(unsigned int)
+{
+	ThreadCounters counters = { false, 0, 0 };
+	return counters;
+}
+
+#endif
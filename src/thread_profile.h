@@ -0,0 +1,78 @@
+#define _CRT_SECURE_NO_WARNINGS
+
+#ifndef THREAD_PROFILE_H_
+#define THREAD_PROFILE_H_
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+//-- What a thread does, each role is placed on its own CPUs by the thread profile
+#define THREAD_ROLE_CAPTURE        0   /* camera setup, the librealsense threads inherit its placement */
+#define THREAD_ROLE_LOCATOR        1   /* the frame thread running the locator */
+#define THREAD_ROLE_WORKER         2   /* task pool workers and the OpenMP threads they start */
+#define THREAD_ROLE_BACKGROUND     3   /* ground estimator, flight recorder writer, debug viewer */
+#define THREAD_ROLE_NUM            4
+
+//-- Sets of roles the counters are read over
+#define THREAD_ROLE_BIT(role)      (1u << (role))
+#define THREAD_ROLES_ALL           ((1u << THREAD_ROLE_NUM) - 1)
+
+typedef struct
+{
+	uint64_t cpus;       /* bit n allows CPU n, 0 leaves the thread to the scheduler */
+	int      priority;   /* SCHED_FIFO priority 1-99, 0 keeps the normal policy */
+
+} ThreadPlacement;
+
+//-- Named placement of every role, picked at start like a capture profile
+typedef struct
+{
+	const char* name;
+
+	ThreadPlacement roles[THREAD_ROLE_NUM];
+
+	int taskThreads;   /* task pool threads including the frame thread, 0 keeps the parameter */
+	int ompThreads;    /* cap of the OpenMP normal estimation, 0 keeps the parameter */
+
+} ThreadProfile;
+
+const ThreadProfile* findThreadProfile(const std::string& name);
+
+std::vector<std::string> threadProfileNames(void);
+
+//-- Threads entering a role from now on are placed by this profile, "default" until set
+void setThreadProfile(const ThreadProfile& profile);
+
+const ThreadProfile& getThreadProfile(void);
+
+//-- Names the calling thread, places it and counts its context switches and migrations from now on,
+//-- false if the system refused the placement, which is reported once
+bool enterThreadRole(int role, const std::string& name);
+
+//-- Stops counting the calling thread, its counts stay in the totals
+void leaveThreadRole(void);
+
+//-- Holds a role for the lifetime of a thread function
+class ThreadRoleScope
+{
+public:
+	ThreadRoleScope(int role, const std::string& name) { enterThreadRole(role, name); }
+	ThreadRoleScope(const ThreadRoleScope&) = delete;
+	ThreadRoleScope& operator=(const ThreadRoleScope&) = delete;
+	~ThreadRoleScope() { leaveThreadRole(); }
+};
+
+//-- Totals over the threads of some roles, a thread counts for the role it is in
+typedef struct
+{
+	bool     available;         /* false if the kernel does not count for us */
+	uint64_t contextSwitches;
+	uint64_t migrations;
+
+} ThreadCounters;
+
+//-- roles is a set of THREAD_ROLE_BIT
+ThreadCounters readThreadCounters(unsigned int roles = THREAD_ROLES_ALL);
+
+#endif
@@ -0,0 +1,180 @@
+//=====================================================
+// field_scene_gen
+// - Renders a synthetic drive over the Robocon field
+// into a sequence file, or benchmarks the locator on
+// synthetic frames at every D435 resolution
+//=====================================================
+#include <iostream>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include "depth_sequence.h"
+#include "field_synth.h"
+#include "robot_locator.h"
+
+using namespace std;
+
+static void printUsage(void)
+{
+	cout << "Usage: field_scene_gen [options] <output sequence>\n"
+		<< "       field_scene_gen --bench [options]\n"
+		<< "  --resolution <WxH>     640x480 (default), 424x240, 848x480 or 1280x720\n"
+		<< "  --frames <n>           number of frames (default: 150)\n"
+		<< "  --fps <n>              frame rate (default: 30)\n"
+		<< "  --speed <m/s>          forward speed of the camera (default: 0.5)\n"
+		<< "  --pose <x,z,h,p,y>     start pose, height in meter, pitch and yaw in degree\n"
+		<< "  --fense <x>            inner face of the left fense (default: -0.25)\n"
+		<< "  --dune <z>             near foot of the dune, negative for none (default: 2.5)\n"
+		<< "  --front-fense <z>      near face of the front fense, negative for none (default: 5.0)\n"
+		<< "  --grassland <z0,z1>    grassland span, z0 negative for none (default: 3.0,4.5)\n"
+		<< "  --seed <n>             noise seed (default: 0)\n"
+		<< "  --clean                no sensor noise\n"
+		<< "  --status <n>           stage the benchmark locates in (default: 1)" << endl;
+}
+
+//-- Locator throughput on synthetic frames of one resolution
+static void benchResolution(FieldSynthesizer& synthesizer, const CameraPose& pose,
+	int width, int height, double speed, double fps, size_t frameNum, unsigned int status)
+{
+	DepthIntrinsics intrinsics;
+	d435Intrinsics(width, height, intrinsics);
+
+	//-- Render up front so only the locator is timed
+	FieldSceneSource scene(synthesizer, intrinsics, pose, speed, fps, frameNum);
+	vector<DepthFrame> frames;
+	DepthFrame frame;
+	while (scene.grab(frame)) { frames.push_back(frame); }
+
+	ReplaySource source(frames);
+	RobotLocator locator(false);
+
+	//-- Every frame goes through the full pipeline and fits the ground on the timed path
+	locator.params.staticReuse = 0;
+	locator.params.groundRate = 0.0;
+	if (!locator.init(source))
+	{
+		cerr << "No ground in the frames of " << width << "x" << height << endl;
+		return;
+	}
+	locator.status = status;
+
+	double total = 0.0;
+	size_t located = 0;
+	size_t detected = 0;
+
+	while (true)
+	{
+		chrono::steady_clock::time_point start = chrono::steady_clock::now();
+
+		if (!locator.updateCloud()) { break; }
+		locator.locate();
+
+		chrono::steady_clock::time_point stop = chrono::steady_clock::now();
+
+		total += chrono::duration_cast<chrono::microseconds>(stop - start).count() / 1000.0;
+		located++;
+		if (locator.getResult().detected) { detected++; }
+	}
+
+	double mean = located ? total / located : 0.0;
+	printf("%5dx%-5d %9d %10.2f %10.1f %9d/%d\n", width, height, width * height, mean,
+		mean > 0.0 ? 1000.0 / mean : 0.0, int(detected), int(located));
+}
+
+int main(int argc, char* argv[])
+{
+	FieldLayout layout;
+	DepthNoiseModel noise;
+	CameraPose pose = { 0.0, 0.0, 0.40, 15.0, 0.0 };
+
+	int width = 640;
+	int height = 480;
+	size_t frameNum = 150;
+	double fps = 30.0;
+	double speed = 0.5;
+	unsigned int seed = 0;
+	unsigned int status = BEFORE_DUNE_STAGE_1;
+	bool bench = false;
+	string outputPath;
+
+	for (int i = 1; i < argc; i++)
+	{
+		string arg = argv[i];
+		bool hasValue = i + 1 < argc;
+
+		if (arg == "--resolution" && hasValue) { sscanf(argv[++i], "%dx%d", &width, &height); }
+		else if (arg == "--frames" && hasValue) { frameNum = atoi(argv[++i]); }
+		else if (arg == "--fps" && hasValue) { fps = atof(argv[++i]); }
+		else if (arg == "--speed" && hasValue) { speed = atof(argv[++i]); }
+		else if (arg == "--pose" && hasValue)
+		{
+			sscanf(argv[++i], "%lf,%lf,%lf,%lf,%lf", &pose.x, &pose.z, &pose.height, &pose.pitch, &pose.yaw);
+		}
+		else if (arg == "--fense" && hasValue) { layout.leftFenseX = atof(argv[++i]); }
+		else if (arg == "--dune" && hasValue)
+		{
+			layout.duneZ = atof(argv[++i]);
+			layout.hasDune = layout.duneZ >= 0.0;
+		}
+		else if (arg == "--front-fense" && hasValue)
+		{
+			layout.frontFenseZ = atof(argv[++i]);
+			layout.hasFrontFense = layout.frontFenseZ >= 0.0;
+		}
+		else if (arg == "--grassland" && hasValue)
+		{
+			sscanf(argv[++i], "%lf,%lf", &layout.grasslandZMin, &layout.grasslandZMax);
+			layout.hasGrassland = layout.grasslandZMin >= 0.0;
+		}
+		else if (arg == "--seed" && hasValue) { seed = atoi(argv[++i]); }
+		else if (arg == "--status" && hasValue) { status = atoi(argv[++i]); }
+		else if (arg == "--clean")
+		{
+			noise.subpixel = 0.0;
+			noise.holeRate = 0.0;
+			noise.flyingPixelRate = 0.0;
+			noise.occlusionShadow = false;
+		}
+		else if (arg == "--bench") { bench = true; }
+		else if (arg.compare(0, 2, "--") == 0 || !outputPath.empty()) { printUsage(); return EXIT_FAILURE; }
+		else { outputPath = arg; }
+	}
+
+	FieldSynthesizer synthesizer(layout, noise, seed);
+
+	if (bench)
+	{
+		printf("%-11s %9s %10s %10s %12s\n", "resolution", "pixels", "mean[ms]", "fps", "detected");
+
+		const int resolutions[][2] = { { 424, 240 }, { 640, 480 }, { 848, 480 }, { 1280, 720 } };
+		for (size_t r = 0; r < sizeof(resolutions) / sizeof(resolutions[0]); r++)
+		{
+			benchResolution(synthesizer, pose, resolutions[r][0], resolutions[r][1], speed, fps, frameNum, status);
+		}
+
+		return EXIT_SUCCESS;
+	}
+
+	DepthIntrinsics intrinsics;
+	if (outputPath.empty() || !d435Intrinsics(width, height, intrinsics))
+	{
+		printUsage();
+		return EXIT_FAILURE;
+	}
+
+	SequenceWriter writer;
+	if (!writer.open(outputPath))
+	{
+		cerr << "Cannot create sequence " << outputPath << endl;
+		return EXIT_FAILURE;
+	}
+
+	FieldSceneSource scene(synthesizer, intrinsics, pose, speed, fps, frameNum);
+	DepthFrame frame;
+	while (scene.grab(frame)) { writer.write(frame); }
+
+	cout << frameNum << " frames of " << width << "x" << height << " written to " << outputPath << endl;
+	return EXIT_SUCCESS;
+}
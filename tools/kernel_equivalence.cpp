@@ -0,0 +1,758 @@
+//=====================================================
+// kernel_equivalence
+// - Runs the PCL reference of each locator step next
+// to the replacement the locator uses for it, on
+// synthetic field frames and recorded sequences, and
+// checks that both agree within the tolerances below
+//
+// Every replacement of VoxelGrid, SOR, normal
+// estimation, SACSegmentation or Euclidean clustering
+// gets a check here before it goes into the locator:
+// add an entry to checkInfos and compare the outputs
+// in runFrame, runLocator or runPlaneTrials
+//=====================================================
+#include <iostream>
+#include <algorithm>
+#include <iterator>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <random>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <Eigen/Dense>
+#include <pcl/point_types.h>
+#include <pcl/filters/passthrough.h>
+#include <pcl/filters/voxel_grid.h>
+#include <pcl/filters/statistical_outlier_removal.h>
+#include <pcl/features/normal_3d_omp.h>
+#include <pcl/search/kdtree.h>
+#include <pcl/sample_consensus/method_types.h>
+#include <pcl/sample_consensus/model_types.h>
+#include <pcl/sample_consensus/sac_model_plane.h>
+#include <pcl/segmentation/sac_segmentation.h>
+#include <pcl/segmentation/extract_clusters.h>
+#include "depth_sequence.h"
+#include "field_synth.h"
+#include "geometry_kernels.h"
+#include "ground_estimator.h"
+#include "line_detector.h"
+#include "locator_params.h"
+#include "morton_order.h"
+#include "parallel_filter.h"
+#include "robot_locator.h"
+
+using namespace std;
+
+typedef pcl::PointXYZ                  CheckPoint;
+typedef pcl::PointCloud<CheckPoint>    CheckCloud;
+typedef pcl::PointCloud<pcl::Normal>   CheckNormals;
+
+//-- Normals further apart than this count as different
+#define NORMAL_ANGLE_TOLERANCE 1.0
+
+//-- Points of the faces fitted in the plane trials
+#define TRIAL_POINTS 3000
+
+enum CheckId
+{
+	CHECK_PASS_THROUGH = 0,
+	CHECK_ROI_CULLING,
+	CHECK_SOR,
+	CHECK_NORMALS,
+	CHECK_NORMAL_SUBSET,
+	CHECK_PLANE_INLIERS,
+	CHECK_HEIGHT_BANDS,
+	CHECK_PLANE_ANGLE,
+	CHECK_PLANE_OFFSET,
+	CHECK_SEGMENT_ANGLE,
+	CHECK_SEGMENT_OFFSET,
+	CHECK_CLUSTERS,
+	CHECK_NUM
+};
+
+//-- What is compared, the worst value of a run must stay at or below the tolerance
+typedef struct
+{
+	const char* name;
+	const char* reference;
+	const char* replacement;
+	const char* metric;
+	double      tolerance;
+
+} CheckInfo;
+
+static const CheckInfo checkInfos[CHECK_NUM] =
+{
+	{ "pass through",   "PassThrough x, z",       "boxMask compaction",     "points differing",       0.0   },
+	{ "roi culling",    "full deprojection",      "deprojectDepthWindows",  "ROI points differing",   0.0   },
+	{ "outlier kNN",    "SOR in grid order",      "SOR in Morton order",    "share of points kept differently", 0.001 },
+	{ "normals",        "NormalEstimationOMP",    "same in Morton order",   "share of normals off",   0.001 },
+	{ "normal subset",  "NormalEstimationOMP",    "setIndices subset",      "share of normals off",   0.001 },
+	{ "plane inliers",  "SAC plane model",        "distanceMask",           "share of points differing", 0.0001 },
+	{ "height bands",   "normals removal",        "height bands removal",   "share of points kept differently", 0.02 },
+	{ "plane angle",    "SACSegmentation",        "fitTracePlane",          "normal angle, degree",   2.0   },
+	{ "plane offset",   "SACSegmentation",        "fitTracePlane",          "offset, meter",          0.02  },
+	{ "segment angle",  "SACSegmentation in ROI", "plane segment map",      "normal angle, degree",   2.0   },
+	{ "segment offset", "SACSegmentation in ROI", "plane segment map",      "offset, meter",          0.02  },
+	{ "clusters",       "clusters in grid order", "same in Morton order",   "share of points moved",  0.0   }
+};
+
+typedef struct
+{
+	double referenceMs;
+	double replacementMs;
+	double worst;
+	size_t runs;
+	size_t failures;
+
+} CheckStats;
+
+static CheckStats checkStats[CHECK_NUM];
+
+static double elapsedMs(chrono::steady_clock::time_point start)
+{
+	return chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+}
+
+static inline const float* floatsOf(const CheckCloud& cloud) { return reinterpret_cast<const float*>(cloud.points.data()); }
+
+static const size_t pointStride = sizeof(CheckPoint) / sizeof(float);
+
+static void record(CheckId id, double referenceMs, double replacementMs, double value)
+{
+	CheckStats& stats = checkStats[id];
+
+	stats.referenceMs += referenceMs;
+	stats.replacementMs += replacementMs;
+	stats.worst = (stats.runs == 0) ? value : max(stats.worst, value);
+	stats.runs++;
+	if (!(value <= checkInfos[id].tolerance)) { stats.failures++; }
+}
+
+static void printUsage(void)
+{
+	cout << "Usage: kernel_equivalence [options] [sequence]...\n"
+		<< "  --frames <n>           frames per sequence, or synthetic frames without one (default: 10)\n"
+		<< "  --trials <n>           synthetic fense and dune faces for the plane fits (default: 20)\n"
+		<< "  --threads <n>          task pool threads, 0 takes every hardware thread (default: 0)\n"
+		<< "  --set <name=value>     locator parameter, scaled to the stream like the locator does\n"
+		<< "Exits with failure if any replacement is out of tolerance" << endl;
+}
+
+//-- Points equal in all three coordinates, for comparing point sets regardless of order
+static bool pointLess(const CheckPoint& a, const CheckPoint& b)
+{
+	if (a.x != b.x) { return a.x < b.x; }
+	if (a.y != b.y) { return a.y < b.y; }
+	return a.z < b.z;
+}
+
+static size_t pointSetDifference(vector<CheckPoint> a, vector<CheckPoint> b)
+{
+	sort(a.begin(), a.end(), pointLess);
+	sort(b.begin(), b.end(), pointLess);
+
+	vector<CheckPoint> difference;
+	set_symmetric_difference(a.begin(), a.end(), b.begin(), b.end(), back_inserter(difference), pointLess);
+
+	return difference.size();
+}
+
+//-- Angle between two unit normals in degree, NaN on one side only is as far apart as it gets
+static double normalAngle(const pcl::Normal& a, const pcl::Normal& b)
+{
+	bool aValid = std::isfinite(a.normal_x), bValid = std::isfinite(b.normal_x);
+	if (!aValid || !bValid) { return (aValid == bValid) ? 0.0 : 180.0; }
+
+	double dot = double(a.normal_x) * b.normal_x + double(a.normal_y) * b.normal_y + double(a.normal_z) * b.normal_z;
+	return acos(max(-1.0, min(1.0, dot))) * 180.0 / M_PI;
+}
+
+//-- Points of a locator cloud, whose point type depends on the build, as check points
+template <typename CloudT>
+static vector<CheckPoint> checkPointsOf(const CloudT& cloud)
+{
+	vector<CheckPoint> points;
+	points.reserve(cloud.points.size());
+
+	for (size_t i = 0; i < cloud.points.size(); i++)
+	{
+		points.push_back(CheckPoint(cloud.points[i].x, cloud.points[i].y, cloud.points[i].z));
+	}
+
+	return points;
+}
+
+//-- Normal angle and offset between two planes, NULL for a plane that was not found
+static void recordPlanes(CheckId angleId, CheckId offsetId, double referenceMs, double replacementMs,
+	const float* referencePlane, const float* replacementPlane)
+{
+	if (referencePlane == NULL || replacementPlane == NULL)
+	{
+		record(angleId, referenceMs, replacementMs, 180.0);
+		record(offsetId, 0.0, 0.0, 1e9);
+		return;
+	}
+
+	float reference[4], replacement[4];
+	normalizePlane(referencePlane, reference);
+	normalizePlane(replacementPlane, replacement);
+
+	//-- Both signs describe the same plane
+	float dot = reference[0] * replacement[0] + reference[1] * replacement[1] + reference[2] * replacement[2];
+	float sign = (dot < 0.0f) ? -1.0f : 1.0f;
+
+	record(angleId, referenceMs, replacementMs, acos(min(1.0f, fabs(dot))) * 180.0 / M_PI);
+	record(offsetId, 0.0, 0.0, fabs(reference[3] - sign * replacement[3]));
+}
+
+static CheckNormals::Ptr estimateNormals(CheckCloud::Ptr cloud, const LocatorParams& params, const vector<int>* indices = NULL)
+{
+	pcl::NormalEstimationOMP<CheckPoint, pcl::Normal> estimation;
+	estimation.setNumberOfThreads(params.normalThreads);
+	estimation.setInputCloud(cloud);
+	if (indices != NULL) { estimation.setIndices(pcl::IndicesPtr(new vector<int>(*indices))); }
+
+	pcl::search::KdTree<CheckPoint>::Ptr tree(new pcl::search::KdTree<CheckPoint>);
+	estimation.setSearchMethod(tree);
+	estimation.setRadiusSearch(params.horizontalNormalRadius);
+
+	CheckNormals::Ptr normals(new CheckNormals);
+	estimation.compute(*normals);
+
+	return normals;
+}
+
+//-- Cluster of every point, -1 for points in none, like the stages run it
+static void clusterLabels(CheckCloud::Ptr cloud, const LocatorParams& params, vector<int>& labels)
+{
+	pcl::search::KdTree<CheckPoint>::Ptr tree(new pcl::search::KdTree<CheckPoint>);
+	tree->setInputCloud(cloud);
+
+	vector<pcl::PointIndices> clusters;
+	pcl::EuclideanClusterExtraction<CheckPoint> extraction;
+	extraction.setClusterTolerance(params.clusterTolerance);
+	extraction.setMinClusterSize(100);
+	extraction.setMaxClusterSize(25000);
+	extraction.setSearchMethod(tree);
+	extraction.setInputCloud(cloud);
+	extraction.extract(clusters);
+
+	labels.assign(cloud->points.size(), -1);
+	for (size_t c = 0; c < clusters.size(); c++)
+	{
+		for (size_t i = 0; i < clusters[c].indices.size(); i++) { labels[clusters[c].indices[i]] = int(c); }
+	}
+}
+
+//===================================================
+// runFrame
+// - Takes one depth frame through the preprocessing
+// of the locator, comparing each step on the way
+//===================================================
+static void runFrame(const DepthFrame& source, const LocatorParams& params, TaskPool& pool)
+{
+	DepthFrame frame = source;
+	decimateDepthFrame(frame, resolveDecimation(params.depthDecimation, frame.intrinsics.width));
+
+	CheckCloud::Ptr raw(new CheckCloud);
+	deprojectDepthFrame(frame, *raw);
+
+	//-- Pass through: two PassThrough filters against one box kernel compaction
+	chrono::steady_clock::time_point start = chrono::steady_clock::now();
+	CheckCloud::Ptr passed(new CheckCloud);
+	pcl::PassThrough<CheckPoint> pass;
+	pass.setInputCloud(raw);
+	pass.setFilterFieldName("x");
+	pass.setFilterLimits(-1.0f, 1.0f);
+	pass.filter(*passed);
+	pass.setInputCloud(passed);
+	pass.setFilterFieldName("z");
+	pass.setFilterLimits(0.0f, 4.0f);
+	pass.filter(*passed);
+	double referenceMs = elapsedMs(start);
+
+	start = chrono::steady_clock::now();
+	ObjectROI passROI = PASS_ROI;
+	const float passBox[4] = { float(passROI.xMin), float(passROI.xMax), float(passROI.zMin), float(passROI.zMax) };
+	vector<int> passIndices;
+	parallelSelectMasked(pool, raw->points.size(), [&](size_t begin, size_t end, uint8_t* flags)
+	{
+		boxMask(floatsOf(*raw) + begin * pointStride, pointStride, NULL, end - begin, passBox, flags + begin);
+	}, passIndices);
+	CheckCloud::Ptr compacted(new CheckCloud);
+	parallelGather(pool, *raw, passIndices, *compacted);
+	double replacementMs = elapsedMs(start);
+
+	//-- Same points in the same order
+	size_t differing = (passed->points.size() > compacted->points.size()) ?
+		passed->points.size() - compacted->points.size() : compacted->points.size() - passed->points.size();
+	for (size_t i = 0; i < min(passed->points.size(), compacted->points.size()); i++)
+	{
+		const CheckPoint& a = passed->points[i];
+		const CheckPoint& b = compacted->points[i];
+		if (a.x != b.x || a.y != b.y || a.z != b.z) { differing++; }
+	}
+	record(CHECK_PASS_THROUGH, referenceMs, replacementMs, double(differing));
+
+	//-- Down sampling and outlier removal, the ground is fitted on the result
+	CheckCloud::Ptr grid(new CheckCloud);
+	pcl::VoxelGrid<CheckPoint> voxel;
+	voxel.setInputCloud(compacted);
+	voxel.setLeafSize(params.voxelLeaf, params.voxelLeaf, params.voxelLeaf);
+	voxel.filter(*grid);
+
+	if (grid->points.size() < size_t(params.sorMeanK) + 1) { return; }
+
+	vector<int> order;
+	mortonOrder(floatsOf(*grid), pointStride, grid->points.size(), float(params.voxelLeaf), order);
+	CheckCloud::Ptr morton(new CheckCloud);
+	parallelGather(pool, *grid, order, *morton);
+
+	//-- Outlier removal: kept points of both layouts, compared by their index in grid order
+	start = chrono::steady_clock::now();
+	vector<int> gridKept;
+	pcl::StatisticalOutlierRemoval<CheckPoint> sor;
+	sor.setInputCloud(grid);
+	sor.setMeanK(params.sorMeanK);
+	sor.setStddevMulThresh(params.sorStddevMul);
+	sor.filter(gridKept);
+	referenceMs = elapsedMs(start);
+
+	start = chrono::steady_clock::now();
+	vector<int> mortonKept;
+	sor.setInputCloud(morton);
+	sor.filter(mortonKept);
+	replacementMs = elapsedMs(start);
+
+	for (size_t i = 0; i < mortonKept.size(); i++) { mortonKept[i] = order[mortonKept[i]]; }
+	sort(gridKept.begin(), gridKept.end());
+	sort(mortonKept.begin(), mortonKept.end());
+
+	vector<int> keptDifference;
+	set_symmetric_difference(gridKept.begin(), gridKept.end(), mortonKept.begin(), mortonKept.end(), back_inserter(keptDifference));
+	record(CHECK_SOR, referenceMs, replacementMs, double(keptDifference.size()) / grid->points.size());
+
+	//-- Normals: per point in both layouts, and for every third point only against the full estimation
+	start = chrono::steady_clock::now();
+	CheckNormals::Ptr gridNormals = estimateNormals(grid, params);
+	referenceMs = elapsedMs(start);
+
+	start = chrono::steady_clock::now();
+	CheckNormals::Ptr mortonNormals = estimateNormals(morton, params);
+	replacementMs = elapsedMs(start);
+
+	size_t normalsOff = 0;
+	for (size_t i = 0; i < order.size(); i++)
+	{
+		if (normalAngle(gridNormals->points[order[i]], mortonNormals->points[i]) > NORMAL_ANGLE_TOLERANCE) { normalsOff++; }
+	}
+	record(CHECK_NORMALS, referenceMs, replacementMs, double(normalsOff) / order.size());
+
+	vector<int> subset;
+	for (size_t i = 0; i < grid->points.size(); i += 3) { subset.push_back(int(i)); }
+
+	start = chrono::steady_clock::now();
+	CheckNormals::Ptr subsetNormals = estimateNormals(grid, params, &subset);
+	replacementMs = elapsedMs(start);
+
+	normalsOff = 0;
+	for (size_t i = 0; i < subset.size(); i++)
+	{
+		if (normalAngle(gridNormals->points[subset[i]], subsetNormals->points[i]) > NORMAL_ANGLE_TOLERANCE) { normalsOff++; }
+	}
+	record(CHECK_NORMAL_SUBSET, referenceMs, replacementMs, double(normalsOff) / subset.size());
+
+	//-- Ground plane the way the locator fits it
+	pcl::ModelCoefficients coefficients;
+	pcl::PointIndices inliers;
+	pcl::SACSegmentation<CheckPoint> seg;
+	seg.setOptimizeCoefficients(true);
+	seg.setModelType(pcl::SACMODEL_PLANE);
+	seg.setMethodType(pcl::SAC_RANSAC);
+	seg.setDistanceThreshold(params.ransacThreshold);
+	seg.setMaxIterations(params.ransacMaxIterations);
+	seg.setInputCloud(grid);
+	seg.segment(inliers, coefficients);
+
+	if (coefficients.values.size() != 4) { return; }
+
+	//-- Plane inliers: PCL's plane model on the SAC coefficients against the kernel on them normalized, like the locator
+	float plane[4];
+	normalizePlane(coefficients.values.data(), plane);
+	const float band = float(params.groundBand);
+
+	start = chrono::steady_clock::now();
+	pcl::SampleConsensusModelPlane<CheckPoint> model(grid);
+	const Eigen::VectorXf modelCoefficients = Eigen::Map<const Eigen::VectorXf>(coefficients.values.data(), 4);
+	vector<int> modelInliers;
+	model.selectWithinDistance(modelCoefficients, band, modelInliers);
+
+	vector<uint8_t> referenceNear(grid->points.size(), 0);
+	for (size_t i = 0; i < modelInliers.size(); i++) { referenceNear[modelInliers[i]] = 1; }
+	referenceMs = elapsedMs(start);
+
+	start = chrono::steady_clock::now();
+	vector<uint8_t> kernelNear(grid->points.size());
+	distanceMask(floatsOf(*grid), pointStride, NULL, grid->points.size(), plane, band, false, kernelNear.data());
+	replacementMs = elapsedMs(start);
+
+	size_t inliersOff = 0;
+	for (size_t i = 0; i < grid->points.size(); i++) { inliersOff += (referenceNear[i] != kernelNear[i]) ? 1 : 0; }
+	record(CHECK_PLANE_INLIERS, referenceMs, replacementMs, double(inliersOff) / grid->points.size());
+
+	GroundSnapshot ground;
+	makeGroundSnapshot(coefficients.values.data(), frame.number, ground);
+
+	//-- ROI culling: the points of a box in front of the camera, from the whole frame and from the windows only
+	const float box[4] = { -0.6f, 0.6f, 0.5f, 2.5f };
+	const float sine = sin(ground.angle), cosine = cos(ground.angle);
+
+	auto insideBox = [&](const CheckPoint& p)
+	{
+		float z = sine * p.y + cosine * p.z;
+		return p.z > 0.0f && box[0] <= p.x && p.x <= box[1] && box[2] <= z && z <= box[3];
+	};
+
+	start = chrono::steady_clock::now();
+	CheckCloud full;
+	deprojectDepthFrame(frame, full);
+	vector<CheckPoint> fullInside;
+	for (size_t i = 0; i < full.points.size(); i++) { if (insideBox(full.points[i])) { fullInside.push_back(full.points[i]); } }
+	referenceMs = elapsedMs(start);
+
+	start = chrono::steady_clock::now();
+	DepthWindows windows(1);
+	makeDepthWindow(frame.intrinsics, ground.angle, box, float(params.roiCullMargin), float(passROI.zMax), windows[0]);
+	CheckCloud culled;
+	deprojectDepthWindows(frame, windows, culled);
+	vector<CheckPoint> culledInside;
+	for (size_t i = 0; i < culled.points.size(); i++) { if (insideBox(culled.points[i])) { culledInside.push_back(culled.points[i]); } }
+	replacementMs = elapsedMs(start);
+
+	record(CHECK_ROI_CULLING, referenceMs, replacementMs, double(pointSetDifference(fullInside, culledInside)));
+
+	//-- Clusters of the points off the ground band, the input of the front fense stage
+	vector<float> heights(grid->points.size());
+	planeDistance(floatsOf(*grid), pointStride, NULL, grid->points.size(), plane, heights.data());
+
+	vector<int> offGround;
+	for (size_t i = 0; i < heights.size(); i++) { if (fabs(heights[i]) > band) { offGround.push_back(int(i)); } }
+	if (offGround.empty()) { return; }
+
+	CheckCloud::Ptr vertical(new CheckCloud);
+	parallelGather(pool, *grid, offGround, *vertical);
+
+	vector<int> verticalOrder;
+	mortonOrder(floatsOf(*vertical), pointStride, vertical->points.size(), float(params.voxelLeaf), verticalOrder);
+	CheckCloud::Ptr verticalMorton(new CheckCloud);
+	parallelGather(pool, *vertical, verticalOrder, *verticalMorton);
+
+	start = chrono::steady_clock::now();
+	vector<int> gridLabels;
+	clusterLabels(vertical, params, gridLabels);
+	referenceMs = elapsedMs(start);
+
+	start = chrono::steady_clock::now();
+	vector<int> mortonLabels;
+	clusterLabels(verticalMorton, params, mortonLabels);
+	replacementMs = elapsedMs(start);
+
+	//-- Cluster numbers differ between the layouts, the partition must not: each reference cluster maps to one
+	//-- cluster of the replacement, taken from its first point, and no two map to the same one
+	vector<int> labelOf(vertical->points.size());
+	for (size_t i = 0; i < verticalOrder.size(); i++) { labelOf[verticalOrder[i]] = mortonLabels[i]; }
+
+	vector<int> mapped(vertical->points.size() + 1, -2);
+	vector<char> taken(vertical->points.size() + 1, 0);
+	size_t moved = 0;
+
+	for (size_t i = 0; i < gridLabels.size(); i++)
+	{
+		int reference = gridLabels[i], replacement = labelOf[i];
+
+		if (reference < 0 || replacement < 0)
+		{
+			moved += (reference != replacement) ? 1 : 0;
+			continue;
+		}
+
+		if (mapped[reference] == -2)
+		{
+			if (taken[replacement]) { moved++; continue; }
+			mapped[reference] = replacement;
+			taken[replacement] = 1;
+		}
+
+		moved += (mapped[reference] != replacement) ? 1 : 0;
+	}
+	record(CHECK_CLUSTERS, referenceMs, replacementMs, double(moved) / gridLabels.size());
+}
+
+//===================================================
+// runLocator
+// - Drives a locator through the first stage and
+// has it remove the horizontal planes and fit the
+// stage ROIs both ways on each frame, the stage then
+// runs on the parameters as given and moves the ROIs
+//===================================================
+static void runLocator(const vector<DepthFrame>& frames, const LocatorParams& params)
+{
+	ReplaySource source(frames);
+	RobotLocator locator(false);
+
+	//-- Reused results would skip the frames
+	locator.params = params;
+	locator.params.staticReuse = 0;
+	if (!locator.init(source)) { return; }
+
+	//-- Scaled on init, the checks below switch the detectors only
+	const LocatorParams stageParams = locator.params;
+
+	while (true)
+	{
+		locator.status = BEFORE_DUNE_STAGE_1;
+		if (!locator.updateCloud()) { break; }
+
+		//-- Height bands first, they estimate their own normals and must not find the full estimation ready
+		locator.params.horizontalRemoval = HORIZONTAL_REMOVAL_HEIGHT_BANDS;
+		locator.requireFeatures(FEATURE_GROUND_PLANE);
+		RobotLocator::CloudPtr filtered = locator.getFilteredCloud();
+
+		chrono::steady_clock::time_point start = chrono::steady_clock::now();
+		vector<CheckPoint> bands = checkPointsOf(*locator.removeHorizontalPlane(filtered));
+		double replacementMs = elapsedMs(start);
+
+		locator.params.horizontalRemoval = HORIZONTAL_REMOVAL_NORMALS;
+		start = chrono::steady_clock::now();
+		locator.requireFeatures(FEATURE_VERTICAL_CLOUD);
+		double referenceMs = elapsedMs(start);
+
+		RobotLocator::CloudPtr vertical = locator.getVerticalCloud();
+		if (!filtered->points.empty())
+		{
+			record(CHECK_HEIGHT_BANDS, referenceMs, replacementMs,
+				double(pointSetDifference(checkPointsOf(*vertical), bands)) / filtered->points.size());
+		}
+
+		//-- ROI planes: SACSegmentation on the points of each ROI against the largest segment of the plane map in it
+		locator.requireFeatures(FEATURE_VERTICAL_NORMALS);
+		const ObjectROI rois[2] = { locator.getLeftFenseROI(), locator.getDuneROI() };
+		pcl::ModelCoefficients::Ptr sacPlanes[2], mapPlanes[2];
+		bool sacFound[2], segmentFound[2];
+
+		locator.params.planeDetector = PLANE_DETECTOR_RANSAC;
+		start = chrono::steady_clock::now();
+		for (int r = 0; r < 2; r++)
+		{
+			pcl::PointIndices::Ptr inliers(new pcl::PointIndices);
+			sacPlanes[r].reset(new pcl::ModelCoefficients);
+			sacFound[r] = locator.extractPlaneWithinROI(vertical, rois[r], inliers, sacPlanes[r]);
+		}
+		referenceMs = elapsedMs(start);
+
+		locator.params.planeDetector = PLANE_DETECTOR_SEGMENT_MAP;
+		start = chrono::steady_clock::now();
+		locator.requireFeatures(FEATURE_PLANE_MAP);
+		for (int r = 0; r < 2; r++)
+		{
+			pcl::PointIndices::Ptr inliers(new pcl::PointIndices);
+			mapPlanes[r].reset(new pcl::ModelCoefficients);
+			segmentFound[r] = locator.extractPlaneWithinROI(vertical, rois[r], inliers, mapPlanes[r]);
+		}
+		replacementMs = elapsedMs(start);
+
+		for (int r = 0; r < 2; r++)
+		{
+			//-- Nothing in the ROI for either is no deviation
+			if (!sacFound[r] && !segmentFound[r]) { continue; }
+
+			recordPlanes(CHECK_SEGMENT_ANGLE, CHECK_SEGMENT_OFFSET, referenceMs, replacementMs,
+				sacFound[r] ? sacPlanes[r]->values.data() : NULL, segmentFound[r] ? mapPlanes[r]->values.data() : NULL);
+
+			//-- The times are those of both ROIs, count them once
+			referenceMs = replacementMs = 0.0;
+		}
+
+		locator.params = stageParams;
+		locator.locate();
+	}
+}
+
+//===================================================
+// runPlaneTrials
+// - Fense and dune faces with sensor noise and
+// clutter around them, in the leveled frame the
+// stages fit them in, RANSAC against the trace fit
+//===================================================
+static void runPlaneTrials(int trials, const LocatorParams& params)
+{
+	mt19937 random(1);
+	normal_distribution<float> noise(0.0f, 0.004f);
+	uniform_real_distribution<float> unit(0.0f, 1.0f);
+
+	for (int t = 0; t < trials; t++)
+	{
+		//-- Even trials are a vertical fense face, odd ones a dune slope, both turned about the y-axis
+		float slope = (t % 2 == 0) ? 0.0f : float(30.0 + 30.0 * unit(random));
+		float yaw = float((unit(random) - 0.5) * 60.0);
+		float slopeRad = slope * float(M_PI) / 180.0f, yawRad = yaw * float(M_PI) / 180.0f;
+
+		//-- Unit normal and a point of the face, the camera sits 0.4 m above the ground at y = 0.4
+		Eigen::Vector3f normal(cos(slopeRad) * cos(yawRad), sin(slopeRad), cos(slopeRad) * sin(yawRad));
+		Eigen::Vector3f along(-sin(yawRad), 0.0f, cos(yawRad));
+		Eigen::Vector3f up = normal.cross(along).normalized();
+		if (up[1] < 0.0f) { up = -up; }
+		Eigen::Vector3f origin(-0.3f + 0.2f * unit(random), 0.35f, 1.5f);
+
+		CheckCloud::Ptr cloud(new CheckCloud);
+		for (int i = 0; i < TRIAL_POINTS; i++)
+		{
+			Eigen::Vector3f p;
+
+			if (i % 10 < 8)
+			{
+				p = origin + along * (unit(random) - 0.5f) * 1.5f + up * unit(random) * 0.12f + normal * noise(random);
+			}
+			else
+			{
+				//-- Clutter in the ROI, grass tips and flying pixels
+				p = origin + Eigen::Vector3f((unit(random) - 0.5f) * 0.6f, unit(random) * 0.1f, (unit(random) - 0.5f) * 1.5f);
+			}
+
+			cloud->points.push_back(CheckPoint(p[0], p[1], p[2]));
+		}
+		cloud->width = uint32_t(cloud->points.size());
+		cloud->height = 1;
+
+		chrono::steady_clock::time_point start = chrono::steady_clock::now();
+		pcl::ModelCoefficients coefficients;
+		pcl::PointIndices inliers;
+		pcl::SACSegmentation<CheckPoint> seg;
+		seg.setOptimizeCoefficients(true);
+		seg.setModelType(pcl::SACMODEL_PLANE);
+		seg.setMethodType(pcl::SAC_RANSAC);
+		seg.setDistanceThreshold(params.ransacThreshold);
+		seg.setMaxIterations(params.ransacMaxIterations);
+		seg.setInputCloud(cloud);
+		seg.segment(inliers, coefficients);
+		double referenceMs = elapsedMs(start);
+
+		start = chrono::steady_clock::now();
+		float trace[4];
+		bool traced = fitTracePlane(floatsOf(*cloud), pointStride, NULL, cloud->points.size(),
+			float(params.ransacThreshold), float(params.planeDistance), params.ransacMaxIterations, trace);
+		double replacementMs = elapsedMs(start);
+
+		recordPlanes(CHECK_PLANE_ANGLE, CHECK_PLANE_OFFSET, referenceMs, replacementMs,
+			(coefficients.values.size() == 4) ? coefficients.values.data() : NULL, traced ? trace : NULL);
+	}
+}
+
+int main(int argc, char** argv)
+{
+	vector<string> sequencePaths;
+	size_t frameLimit = 10;
+	int trials = 20;
+	unsigned int threads = 0;
+	LocatorParams params;
+
+	for (int i = 1; i < argc; i++)
+	{
+		string arg = argv[i];
+
+		if (arg == "--frames" && i + 1 < argc) { frameLimit = size_t(max(1, atoi(argv[++i]))); }
+		else if (arg == "--trials" && i + 1 < argc) { trials = max(0, atoi(argv[++i])); }
+		else if (arg == "--threads" && i + 1 < argc) { threads = unsigned(max(0, atoi(argv[++i]))); }
+		else if (arg == "--set" && i + 1 < argc)
+		{
+			string text = argv[++i];
+			size_t eq = text.find('=');
+
+			if (eq == string::npos || !setLocatorParam(params, text.substr(0, eq), atof(text.substr(eq + 1).c_str())))
+			{
+				cerr << "Bad parameter " << text << endl;
+				return EXIT_FAILURE;
+			}
+		}
+		else if (arg.compare(0, 2, "--") == 0) { printUsage(); return EXIT_FAILURE; }
+		else { sequencePaths.push_back(arg); }
+	}
+
+	//-- Recorded frames, or a synthetic drive over the field without any
+	vector<DepthFrame> frames;
+
+	for (size_t s = 0; s < sequencePaths.size(); s++)
+	{
+		vector<DepthFrame> sequence;
+		if (!loadSequence(sequencePaths[s], sequence) || sequence.empty())
+		{
+			cerr << "Cannot open sequence " << sequencePaths[s] << endl;
+			return EXIT_FAILURE;
+		}
+		if (sequence.size() > frameLimit) { sequence.resize(frameLimit); }
+		frames.insert(frames.end(), sequence.begin(), sequence.end());
+	}
+
+	if (sequencePaths.empty())
+	{
+		DepthIntrinsics intrinsics;
+		d435Intrinsics(640, 480, intrinsics);
+
+		FieldLayout layout;
+		DepthNoiseModel noise;
+		FieldSynthesizer synthesizer(layout, noise);
+		CameraPose pose = { 0.0, 0.0, 0.40, 15.0, 0.0 };
+		FieldSceneSource scene(synthesizer, intrinsics, pose, 0.5, 30.0, frameLimit);
+
+		DepthFrame frame;
+		while (scene.grab(frame)) { frames.push_back(frame); }
+	}
+
+	//-- The locator scales its own copy on init
+	const LocatorParams locatorParams = params;
+	if (params.scaleToResolution && !frames.empty()) { scaleLocatorParams(params, frames[0].intrinsics.fx); }
+
+	TaskPool pool(threads, "check");
+
+	for (size_t f = 0; f < frames.size(); f++) { runFrame(frames[f], params, pool); }
+	runLocator(frames, locatorParams);
+	runPlaneTrials(trials, params);
+
+	printf("%zu frames (%s), %d plane trials, kernels %s\n", frames.size(),
+		sequencePaths.empty() ? "synthetic" : "recorded", trials, kernelInstructionSet());
+	printf("%-14s %-24s %-24s %10s %10s %8s %12s %10s  %s\n",
+		"check", "reference", "replacement", "ref ms", "new ms", "speedup", "worst", "tolerance", "result");
+
+	bool passed = true;
+	for (int c = 0; c < CHECK_NUM; c++)
+	{
+		const CheckInfo& info = checkInfos[c];
+		const CheckStats& stats = checkStats[c];
+
+		if (stats.runs == 0)
+		{
+			printf("%-14s %-24s %-24s %10s %10s %8s %12s %10g  %s\n", info.name, info.reference, info.replacement,
+				"-", "-", "-", "-", info.tolerance, "not run");
+			continue;
+		}
+
+		if (stats.failures > 0) { passed = false; }
+
+		char times[3][16] = { "-", "-", "-" };
+		if (stats.replacementMs > 0.0)
+		{
+			snprintf(times[0], sizeof(times[0]), "%.3f", stats.referenceMs / stats.runs);
+			snprintf(times[1], sizeof(times[1]), "%.3f", stats.replacementMs / stats.runs);
+			snprintf(times[2], sizeof(times[2]), "%.2fx", stats.referenceMs / stats.replacementMs);
+		}
+
+		printf("%-14s %-24s %-24s %10s %10s %8s %12.6g %10g  %s (%zu/%zu), %s\n", info.name, info.reference, info.replacement,
+			times[0], times[1], times[2], stats.worst, info.tolerance,
+			stats.failures ? "FAIL" : "ok", stats.runs - stats.failures, stats.runs, info.metric);
+	}
+
+	return passed ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,410 @@
+//=====================================================
+// locator_regression
+// - Runs the locator over a labeled corpus of recorded
+// sequences, scores accuracy, detection failures,
+// stage transition timing and latency, and fails if
+// any of them regressed against a saved baseline
+//
+// Corpus manifest, paths relative to the manifest:
+//   # sequence          labels               start status
+//   dune_approach.seq   dune_approach.txt    1
+//
+// Labels, one line per annotated frame, "-" if unknown:
+//   # number status xDistance zDistance duneDistance fenseDistance angle
+//   1042     1      -0.52     2.10      -            -             3.5
+//=====================================================
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <map>
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include "depth_sequence.h"
+#include "robot_locator.h"
+
+using namespace std;
+
+//-- Ground truth of one frame, keyed by the camera frame number
+typedef struct
+{
+	unsigned int status;
+	double values[5];   /* xDistance, zDistance, duneDistance, fenseDistance, angle */
+
+} FrameLabel;
+
+typedef struct
+{
+	string name;
+	string sequencePath;
+	string labelPath;
+	unsigned int startStatus;
+
+} CorpusEntry;
+
+//-- Everything the harness scores, lower is better for all of them
+typedef struct
+{
+	double distanceError;     /* mean absolute, meter */
+	double angleError;        /* mean absolute, degree */
+	double failureRate;       /* annotated values the locator did not publish */
+	double transitionDelay;   /* mean absolute, frames */
+	double meanLatency;       /* milliseconds */
+	double p95Latency;        /* milliseconds */
+
+} Score;
+
+//-- Sums over frames, several sequences add up into one total
+typedef struct
+{
+	double distanceSum;
+	int distanceCount;
+	double angleSum;
+	int angleCount;
+	int annotated;
+	int failures;
+	double delaySum;
+	int transitions;
+	vector<double> latencies;
+
+} ScoreSums;
+
+static const char* scoreKeys[] =
+{
+	"distanceError", "angleError", "failureRate", "transitionDelay", "meanLatency", "p95Latency"
+};
+
+static double* scoreField(Score& score, int i)
+{
+	double* fields[] = { &score.distanceError, &score.angleError, &score.failureRate,
+		&score.transitionDelay, &score.meanLatency, &score.p95Latency };
+	return fields[i];
+}
+
+static void printUsage(void)
+{
+	cout << "Usage: locator_regression [options] <corpus manifest>\n"
+		<< "  --baseline <file>            fail on regressions against this baseline\n"
+		<< "  --save-baseline <file>       store this run as the new baseline\n"
+		<< "  --max-distance-increase <m>  tolerated distance error increase (default: 0.01)\n"
+		<< "  --max-angle-increase <deg>   tolerated angle error increase (default: 1.0)\n"
+		<< "  --max-failure-increase <r>   tolerated failure rate increase (default: 0.02)\n"
+		<< "  --max-delay-increase <n>     tolerated transition delay increase in frames (default: 1.0)\n"
+		<< "  --max-latency-increase <r>   tolerated relative latency increase (default: 0.10)\n"
+		<< "  --set <name=value>           override a locator parameter" << endl;
+}
+
+static double parseValue(const string& text)
+{
+	return text == "-" ? NAN : atof(text.c_str());
+}
+
+static bool loadLabels(const string& path, map<unsigned long long, FrameLabel>& labels)
+{
+	ifstream file(path.c_str());
+	if (!file.is_open()) { return false; }
+
+	string line;
+	while (getline(file, line))
+	{
+		if (line.empty() || line[0] == '#') { continue; }
+
+		stringstream fields(line);
+		unsigned long long number;
+		FrameLabel label;
+		string value[5];
+
+		if (!(fields >> number >> label.status >> value[0] >> value[1] >> value[2] >> value[3] >> value[4]))
+		{
+			return false;
+		}
+
+		for (int i = 0; i < 5; i++) { label.values[i] = parseValue(value[i]); }
+		labels[number] = label;
+	}
+
+	return true;
+}
+
+static bool loadManifest(const string& path, vector<CorpusEntry>& entries)
+{
+	ifstream file(path.c_str());
+	if (!file.is_open()) { return false; }
+
+	size_t slash = path.find_last_of("/\\");
+	string directory = slash == string::npos ? "" : path.substr(0, slash + 1);
+
+	string line;
+	while (getline(file, line))
+	{
+		if (line.empty() || line[0] == '#') { continue; }
+
+		stringstream fields(line);
+		CorpusEntry entry;
+		if (!(fields >> entry.sequencePath >> entry.labelPath >> entry.startStatus)) { return false; }
+
+		entry.name = entry.sequencePath;
+		entry.sequencePath = directory + entry.sequencePath;
+		entry.labelPath = directory + entry.labelPath;
+		entries.push_back(entry);
+	}
+
+	return true;
+}
+
+static bool loadScore(const string& path, Score& score)
+{
+	ifstream file(path.c_str());
+	if (!file.is_open()) { return false; }
+
+	int found = 0;
+	string line;
+	while (getline(file, line))
+	{
+		size_t eq = line.find('=');
+		if (eq == string::npos) { continue; }
+
+		for (int i = 0; i < 6; i++)
+		{
+			if (line.substr(0, eq) == scoreKeys[i])
+			{
+				*scoreField(score, i) = atof(line.substr(eq + 1).c_str());
+				found++;
+			}
+		}
+	}
+
+	return found == 6;
+}
+
+static void saveScore(const string& path, Score score)
+{
+	ofstream file(path.c_str());
+	for (int i = 0; i < 6; i++)
+	{
+		file << scoreKeys[i] << "=" << *scoreField(score, i) << endl;
+	}
+}
+
+static void runEntry(const CorpusEntry& entry, const vector<DepthFrame>& frames,
+	const map<unsigned long long, FrameLabel>& labels, const LocatorParams& params, ScoreSums& sums)
+{
+	ReplaySource source(frames);
+	RobotLocator locator(false);
+
+	locator.params = params;
+	if (!locator.init(source))
+	{
+		cerr << "No ground in the first frames of " << entry.name << ", entry not scored" << endl;
+		return;
+	}
+	locator.status = entry.startStatus;
+
+	vector<LocateResult> results;
+
+	while (true)
+	{
+		chrono::steady_clock::time_point start = chrono::steady_clock::now();
+
+		if (!locator.updateCloud()) { break; }
+		locator.locate();
+
+		chrono::steady_clock::time_point stop = chrono::steady_clock::now();
+
+		sums.latencies.push_back(chrono::duration_cast<chrono::microseconds>(stop - start).count() / 1000.0);
+		results.push_back(locator.getResult());
+	}
+
+	unsigned int lastLabelStatus = entry.startStatus;
+
+	for (size_t i = 0; i < results.size(); i++)
+	{
+		map<unsigned long long, FrameLabel>::const_iterator found = labels.find(results[i].number);
+		if (found == labels.end()) { continue; }
+
+		const FrameLabel& label = found->second;
+		double published[5] = { results[i].xDistance, results[i].zDistance,
+			results[i].duneDistance, results[i].fenseDistance, results[i].angle };
+
+		//-- Values of a wrong stage are not comparable, they count as failures
+		for (int v = 0; v < 5; v++)
+		{
+			if (std::isnan(label.values[v])) { continue; }
+
+			sums.annotated++;
+
+			if (results[i].status != label.status || std::isnan(published[v]))
+			{
+				sums.failures++;
+			}
+			else if (v == 4)
+			{
+				sums.angleSum += abs(published[v] - label.values[v]);
+				sums.angleCount++;
+			}
+			else
+			{
+				sums.distanceSum += abs(published[v] - label.values[v]);
+				sums.distanceCount++;
+			}
+		}
+
+		//-- Delay between an annotated stage change and the locator getting there
+		if (label.status != lastLabelStatus)
+		{
+			size_t reached = i;
+			while (reached < results.size() && results[reached].status < label.status) { reached++; }
+
+			//-- Also look for a transition the locator made too early
+			size_t early = i;
+			while (early > 0 && results[early - 1].status >= label.status) { early--; }
+
+			sums.delaySum += (early < i) ? double(i - early) : double(reached - i);
+			sums.transitions++;
+			lastLabelStatus = label.status;
+		}
+	}
+}
+
+static Score finalizeScore(ScoreSums sums)
+{
+	Score score;
+	score.distanceError = sums.distanceCount ? sums.distanceSum / sums.distanceCount : 0.0;
+	score.angleError = sums.angleCount ? sums.angleSum / sums.angleCount : 0.0;
+	score.failureRate = sums.annotated ? double(sums.failures) / sums.annotated : 0.0;
+	score.transitionDelay = sums.transitions ? sums.delaySum / sums.transitions : 0.0;
+
+	sort(sums.latencies.begin(), sums.latencies.end());
+	score.meanLatency = 0.0;
+	for (size_t i = 0; i < sums.latencies.size(); i++) { score.meanLatency += sums.latencies[i]; }
+	score.meanLatency = sums.latencies.empty() ? 0.0 : score.meanLatency / sums.latencies.size();
+	score.p95Latency = sums.latencies.empty() ? 0.0 : sums.latencies[size_t(0.95 * (sums.latencies.size() - 1))];
+
+	return score;
+}
+
+static void addSums(ScoreSums& total, const ScoreSums& sums)
+{
+	total.distanceSum += sums.distanceSum;
+	total.distanceCount += sums.distanceCount;
+	total.angleSum += sums.angleSum;
+	total.angleCount += sums.angleCount;
+	total.annotated += sums.annotated;
+	total.failures += sums.failures;
+	total.delaySum += sums.delaySum;
+	total.transitions += sums.transitions;
+	total.latencies.insert(total.latencies.end(), sums.latencies.begin(), sums.latencies.end());
+}
+
+static void printScore(const string& name, const Score& score)
+{
+	printf("%-28s %9.4f %9.3f %9.4f %9.2f %9.2f %9.2f\n", name.c_str(), score.distanceError, score.angleError,
+		score.failureRate, score.transitionDelay, score.meanLatency, score.p95Latency);
+}
+
+int main(int argc, char* argv[])
+{
+	string manifestPath;
+	string baselinePath;
+	string saveBaselinePath;
+	LocatorParams params;
+	vector<string> setNames;
+
+	//-- Absolute increase for accuracy scores, relative increase for latency
+	double tolerance[6] = { 0.01, 1.0, 0.02, 1.0, 0.10, 0.10 };
+
+	for (int i = 1; i < argc; i++)
+	{
+		string arg = argv[i];
+
+		if (arg == "--baseline" && i + 1 < argc) { baselinePath = argv[++i]; }
+		else if (arg == "--save-baseline" && i + 1 < argc) { saveBaselinePath = argv[++i]; }
+		else if (arg == "--max-distance-increase" && i + 1 < argc) { tolerance[0] = atof(argv[++i]); }
+		else if (arg == "--max-angle-increase" && i + 1 < argc) { tolerance[1] = atof(argv[++i]); }
+		else if (arg == "--max-failure-increase" && i + 1 < argc) { tolerance[2] = atof(argv[++i]); }
+		else if (arg == "--max-delay-increase" && i + 1 < argc) { tolerance[3] = atof(argv[++i]); }
+		else if (arg == "--max-latency-increase" && i + 1 < argc) { tolerance[4] = tolerance[5] = atof(argv[++i]); }
+		else if (arg == "--set" && i + 1 < argc)
+		{
+			string assignment = argv[++i];
+			size_t eq = assignment.find('=');
+			if (eq == string::npos || !setLocatorParam(params, assignment.substr(0, eq), atof(assignment.substr(eq + 1).c_str())))
+			{
+				cerr << "Bad parameter " << assignment << endl;
+				return EXIT_FAILURE;
+			}
+			setNames.push_back(assignment.substr(0, eq));
+		}
+		else if (arg.compare(0, 2, "--") == 0 || !manifestPath.empty()) { printUsage(); return EXIT_FAILURE; }
+		else { manifestPath = arg; }
+	}
+
+	//-- Sequences replay faster than recorded, a ground refit on the wall clock would make the scores random,
+	//-- fit it on every frame unless asked for the background rate
+	if (find(setNames.begin(), setNames.end(), "groundRate") == setNames.end()) { params.groundRate = 0.0; }
+
+	//-- Republished results would be scored and timed as if they were measured
+	if (find(setNames.begin(), setNames.end(), "staticReuse") == setNames.end()) { params.staticReuse = 0; }
+
+	vector<CorpusEntry> entries;
+	if (manifestPath.empty() || !loadManifest(manifestPath, entries) || entries.empty())
+	{
+		printUsage();
+		return EXIT_FAILURE;
+	}
+
+	printf("%-28s %9s %9s %9s %9s %9s %9s\n", "sequence", "dist[m]", "angle[d]", "failures",
+		"delay[f]", "mean[ms]", "p95[ms]");
+
+	ScoreSums total = ScoreSums();
+
+	for (size_t i = 0; i < entries.size(); i++)
+	{
+		vector<DepthFrame> frames;
+		map<unsigned long long, FrameLabel> labels;
+
+		if (!loadSequence(entries[i].sequencePath, frames) || !loadLabels(entries[i].labelPath, labels))
+		{
+			cerr << "Cannot load " << entries[i].sequencePath << " / " << entries[i].labelPath << endl;
+			return EXIT_FAILURE;
+		}
+
+		ScoreSums sums = ScoreSums();
+		runEntry(entries[i], frames, labels, params, sums);
+		printScore(entries[i].name, finalizeScore(sums));
+
+		addSums(total, sums);
+	}
+
+	Score score = finalizeScore(total);
+	printScore("total", score);
+
+	if (!saveBaselinePath.empty()) { saveScore(saveBaselinePath, score); }
+	if (baselinePath.empty()) { return EXIT_SUCCESS; }
+
+	Score baseline;
+	if (!loadScore(baselinePath, baseline))
+	{
+		cerr << "Cannot load baseline " << baselinePath << endl;
+		return EXIT_FAILURE;
+	}
+
+	bool regressed = false;
+	for (int i = 0; i < 6; i++)
+	{
+		double limit = (i < 4) ? *scoreField(baseline, i) + tolerance[i] : *scoreField(baseline, i) * (1.0 + tolerance[i]);
+
+		if (*scoreField(score, i) > limit)
+		{
+			cout << "REGRESSION " << scoreKeys[i] << ": " << *scoreField(score, i)
+				<< " > " << limit << " (baseline " << *scoreField(baseline, i) << ")" << endl;
+			regressed = true;
+		}
+	}
+
+	cout << (regressed ? "FAILED" : "PASSED") << endl;
+	return regressed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
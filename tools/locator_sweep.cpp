@@ -0,0 +1,412 @@
+//=====================================================
+// locator_sweep
+// - Runs the locator over recorded sequences once per
+// parameter set, in parallel, and reports latency
+// against deviation from the default parameters
+//=====================================================
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <cstdio>
+#include <cstdlib>
+#include "depth_sequence.h"
+#include "robot_locator.h"
+
+using namespace std;
+
+//-- Values swept for one parameter
+typedef struct
+{
+	string name;
+	vector<double> values;
+
+} SweepAxis;
+
+//-- One parameter set and everything measured with it
+typedef struct
+{
+	LocatorParams params;
+	string label;
+
+	vector<double> latencies;   /* milliseconds per frame */
+	vector<LocateResult> results;
+
+	double meanLatency;
+	double p95Latency;
+	double deviation;
+	int missed;
+	bool pareto;
+
+} SweepRun;
+
+static void printUsage(void)
+{
+	cout << "Usage: locator_sweep [options] <sequence> [<sequence> ...]\n"
+		<< "  --threads <n>          parallel runs (default: hardware threads)\n"
+		<< "  --status <n>           stage to start locating in (default: 1)\n"
+		<< "  --grid <name=v1,v2>    values of one parameter, replaces the default grid\n"
+		<< "  --full                 cartesian product instead of one parameter at a time\n"
+		<< "  --miss-penalty <m>     deviation of a value missing on one side (default: 1.0)\n"
+		<< "  --csv <file>           write every run as CSV\n"
+		<< "Parameters:";
+
+	vector<string> names = locatorParamNames();
+	for (size_t i = 0; i < names.size(); i++) { cout << " " << names[i]; }
+	cout << endl;
+}
+
+static bool parseAxis(const string& text, SweepAxis& axis)
+{
+	size_t eq = text.find('=');
+	if (eq == string::npos) { return false; }
+
+	axis.name = text.substr(0, eq);
+	axis.values.clear();
+
+	double dummy;
+	if (!getLocatorParam(LocatorParams(), axis.name, dummy)) { return false; }
+
+	stringstream values(text.substr(eq + 1));
+	string value;
+	while (getline(values, value, ','))
+	{
+		axis.values.push_back(atof(value.c_str()));
+	}
+
+	return !axis.values.empty();
+}
+
+static vector<SweepAxis> defaultAxes(void)
+{
+	const char* grid[] =
+	{
+		"voxelLeaf=0.015,0.02,0.025,0.03,0.04",
+		"sorMeanK=5,10,20",
+		"sorStddevMul=0.05,0.1,0.2,0.5",
+		"ransacThreshold=0.005,0.01,0.02",
+		"horizontalNormalRadius=0.03,0.04,0.05",
+		"horizontalCosine=0.85,0.9,0.95",
+		"verticalSorMeanK=10,20,30",
+		"verticalSorStddevMul=0.05,0.1,0.2",
+		"planeNormalRadius=0.03,0.04,0.05,0.06",
+		"planeCosine=0.7,0.8,0.9",
+		"clusterTolerance=0.05,0.1,0.15"
+	};
+
+	vector<SweepAxis> axes;
+	for (size_t i = 0; i < sizeof(grid) / sizeof(grid[0]); i++)
+	{
+		SweepAxis axis;
+		parseAxis(grid[i], axis);
+		axes.push_back(axis);
+	}
+
+	return axes;
+}
+
+static string labelOf(const vector<pair<string, double> >& changes)
+{
+	if (changes.empty()) { return "defaults"; }
+
+	stringstream label;
+	for (size_t i = 0; i < changes.size(); i++)
+	{
+		label << (i ? " " : "") << changes[i].first << "=" << changes[i].second;
+	}
+
+	return label.str();
+}
+
+//-- Reference run first, then a repeat of it as noise floor of the randomized RANSAC
+static vector<SweepRun> buildRuns(const vector<SweepAxis>& axes, bool full)
+{
+	vector<SweepRun> runs(2);
+	runs[0].label = "defaults";
+	runs[1].label = "defaults (repeat)";
+
+	if (!full)
+	{
+		for (size_t a = 0; a < axes.size(); a++)
+		{
+			double defaultValue;
+			getLocatorParam(LocatorParams(), axes[a].name, defaultValue);
+
+			for (size_t v = 0; v < axes[a].values.size(); v++)
+			{
+				if (abs(axes[a].values[v] - defaultValue) < 1e-9) { continue; }
+
+				SweepRun run;
+				setLocatorParam(run.params, axes[a].name, axes[a].values[v]);
+				run.label = labelOf(vector<pair<string, double> >(1, make_pair(axes[a].name, axes[a].values[v])));
+				runs.push_back(run);
+			}
+		}
+
+		return runs;
+	}
+
+	vector<size_t> digit(axes.size(), 0);
+	while (true)
+	{
+		SweepRun run;
+		vector<pair<string, double> > changes;
+
+		for (size_t a = 0; a < axes.size(); a++)
+		{
+			double defaultValue;
+			getLocatorParam(LocatorParams(), axes[a].name, defaultValue);
+			setLocatorParam(run.params, axes[a].name, axes[a].values[digit[a]]);
+
+			if (abs(axes[a].values[digit[a]] - defaultValue) > 1e-9)
+			{
+				changes.push_back(make_pair(axes[a].name, axes[a].values[digit[a]]));
+			}
+		}
+
+		if (!changes.empty())
+		{
+			run.label = labelOf(changes);
+			runs.push_back(run);
+		}
+
+		size_t a = 0;
+		for (; a < axes.size(); a++)
+		{
+			if (++digit[a] < axes[a].values.size()) { break; }
+			digit[a] = 0;
+		}
+		if (a == axes.size()) { break; }
+	}
+
+	return runs;
+}
+
+static void runSequence(const vector<DepthFrame>& frames, unsigned int status, SweepRun& run)
+{
+	ReplaySource source(frames);
+	RobotLocator locator(false);
+
+	locator.params = run.params;
+	if (!locator.init(source))
+	{
+		cerr << "No ground in the first frames of a sequence, sequence left out" << endl;
+		return;
+	}
+	locator.status = status;
+
+	while (true)
+	{
+		chrono::steady_clock::time_point start = chrono::steady_clock::now();
+
+		if (!locator.updateCloud()) { break; }
+		locator.locate();
+
+		chrono::steady_clock::time_point stop = chrono::steady_clock::now();
+
+		run.latencies.push_back(chrono::duration_cast<chrono::microseconds>(stop - start).count() / 1000.0);
+		run.results.push_back(locator.getResult());
+	}
+}
+
+//-- Absolute difference of one published value, a value on one side only costs missPenalty
+static void accumulateDeviation(double value, double reference, double missPenalty,
+	double& sum, int& count, int& missed)
+{
+	bool hasValue = !std::isnan(value);
+	bool hasReference = !std::isnan(reference);
+
+	if (!hasValue && !hasReference) { return; }
+
+	if (hasValue && hasReference) { sum += abs(value - reference); }
+	else { sum += missPenalty; missed++; }
+
+	count++;
+}
+
+static void scoreRun(SweepRun& run, const SweepRun& reference, double missPenalty)
+{
+	vector<double> sorted = run.latencies;
+	sort(sorted.begin(), sorted.end());
+
+	run.meanLatency = 0.0;
+	for (size_t i = 0; i < sorted.size(); i++) { run.meanLatency += sorted[i]; }
+	run.meanLatency = sorted.empty() ? 0.0 : run.meanLatency / sorted.size();
+	run.p95Latency = sorted.empty() ? 0.0 : sorted[size_t(0.95 * (sorted.size() - 1))];
+
+	double sum = 0.0;
+	int count = 0;
+	run.missed = 0;
+
+	for (size_t i = 0; i < run.results.size() && i < reference.results.size(); i++)
+	{
+		const LocateResult& a = run.results[i];
+		const LocateResult& b = reference.results[i];
+
+		//-- Results of different stages are not comparable, the reference counts as missed
+		bool sameStage = (a.status == b.status);
+
+		//-- Angles are reported in degree, compare them in radian like distances in meter
+		accumulateDeviation(sameStage ? a.xDistance : NAN, b.xDistance, missPenalty, sum, count, run.missed);
+		accumulateDeviation(sameStage ? a.zDistance : NAN, b.zDistance, missPenalty, sum, count, run.missed);
+		accumulateDeviation(sameStage ? a.duneDistance : NAN, b.duneDistance, missPenalty, sum, count, run.missed);
+		accumulateDeviation(sameStage ? a.fenseDistance : NAN, b.fenseDistance, missPenalty, sum, count, run.missed);
+		accumulateDeviation(sameStage ? a.angle / 180.0 * PI : NAN, b.angle / 180.0 * PI, missPenalty, sum, count, run.missed);
+	}
+
+	run.deviation = count ? sum / count : 0.0;
+}
+
+//-- A run is on the Pareto front if no faster run deviates less
+static void markParetoFront(vector<SweepRun>& runs)
+{
+	vector<size_t> order(runs.size());
+	for (size_t i = 0; i < order.size(); i++) { order[i] = i; }
+
+	sort(order.begin(), order.end(), [&runs](size_t a, size_t b)
+	{
+		if (runs[a].meanLatency != runs[b].meanLatency) { return runs[a].meanLatency < runs[b].meanLatency; }
+		return runs[a].deviation < runs[b].deviation;
+	});
+
+	double bestDeviation = 1e300;
+	for (size_t i = 0; i < order.size(); i++)
+	{
+		SweepRun& run = runs[order[i]];
+		run.pareto = run.deviation < bestDeviation;
+		if (run.pareto) { bestDeviation = run.deviation; }
+	}
+}
+
+int main(int argc, char* argv[])
+{
+	unsigned int threadNum = max(1u, thread::hardware_concurrency());
+	unsigned int status = BEFORE_DUNE_STAGE_1;
+	double missPenalty = 1.0;
+	bool full = false;
+	string csvPath;
+	vector<SweepAxis> axes;
+	vector<string> sequencePaths;
+
+	for (int i = 1; i < argc; i++)
+	{
+		string arg = argv[i];
+
+		if (arg == "--threads" && i + 1 < argc) { threadNum = max(1, atoi(argv[++i])); }
+		else if (arg == "--status" && i + 1 < argc) { status = atoi(argv[++i]); }
+		else if (arg == "--miss-penalty" && i + 1 < argc) { missPenalty = atof(argv[++i]); }
+		else if (arg == "--csv" && i + 1 < argc) { csvPath = argv[++i]; }
+		else if (arg == "--full") { full = true; }
+		else if (arg == "--grid" && i + 1 < argc)
+		{
+			SweepAxis axis;
+			if (!parseAxis(argv[++i], axis))
+			{
+				cerr << "Bad grid " << argv[i] << endl;
+				return EXIT_FAILURE;
+			}
+			axes.push_back(axis);
+		}
+		else if (arg.compare(0, 2, "--") == 0) { printUsage(); return EXIT_FAILURE; }
+		else { sequencePaths.push_back(arg); }
+	}
+
+	if (sequencePaths.empty()) { printUsage(); return EXIT_FAILURE; }
+	if (axes.empty()) { axes = defaultAxes(); }
+
+	//-- Load every sequence once, all runs replay them from memory
+	vector<vector<DepthFrame> > sequences(sequencePaths.size());
+	for (size_t i = 0; i < sequencePaths.size(); i++)
+	{
+		if (!loadSequence(sequencePaths[i], sequences[i]))
+		{
+			cerr << "Cannot open sequence " << sequencePaths[i] << endl;
+			return EXIT_FAILURE;
+		}
+		cout << sequencePaths[i] << ": " << sequences[i].size() << " frames" << endl;
+	}
+
+	vector<SweepRun> runs = buildRuns(axes, full);
+
+	//-- Sequences replay faster than recorded, a ground refit on the wall clock would make the scores random,
+	//-- fit it on every frame unless the grid asks for the background rate
+	bool sweepsGroundRate = false;
+	bool sweepsStaticReuse = false;
+	for (size_t a = 0; a < axes.size(); a++)
+	{
+		sweepsGroundRate = sweepsGroundRate || axes[a].name == "groundRate";
+		sweepsStaticReuse = sweepsStaticReuse || axes[a].name == "staticReuse";
+	}
+
+	if (!sweepsGroundRate)
+	{
+		for (size_t i = 0; i < runs.size(); i++) { runs[i].params.groundRate = 0.0; }
+	}
+
+	//-- A republished result costs nothing, it would hide the cost of the parameters under test
+	if (!sweepsStaticReuse)
+	{
+		for (size_t i = 0; i < runs.size(); i++) { runs[i].params.staticReuse = 0; }
+	}
+
+	//-- Parallel runs share the cores, keep each locator single threaded
+	if (threadNum > 1)
+	{
+		for (size_t i = 0; i < runs.size(); i++)
+		{
+			runs[i].params.normalThreads = 1;
+			runs[i].params.taskThreads = 1;
+		}
+	}
+
+	cout << runs.size() << " runs on " << threadNum << " threads" << endl;
+
+	atomic<size_t> nextRun(0);
+	vector<thread> workers;
+
+	for (unsigned int t = 0; t < threadNum; t++)
+	{
+		workers.push_back(thread([&]()
+		{
+			for (size_t r = nextRun++; r < runs.size(); r = nextRun++)
+			{
+				for (size_t s = 0; s < sequences.size(); s++)
+				{
+					runSequence(sequences[s], status, runs[r]);
+				}
+			}
+		}));
+	}
+
+	for (size_t t = 0; t < workers.size(); t++) { workers[t].join(); }
+
+	for (size_t i = 0; i < runs.size(); i++) { scoreRun(runs[i], runs[0], missPenalty); }
+	markParetoFront(runs);
+
+	cout << "\n  run   mean[ms]    p95[ms]  deviation   missed  pareto  parameters" << endl;
+	for (size_t i = 0; i < runs.size(); i++)
+	{
+		const SweepRun& run = runs[i];
+		printf("%5d %10.2f %10.2f %10.4f %8d  %6s  %s\n", int(i), run.meanLatency, run.p95Latency,
+			run.deviation, run.missed, run.pareto ? "*" : "", run.label.c_str());
+	}
+
+	if (!csvPath.empty())
+	{
+		ofstream csv(csvPath.c_str());
+		csv << "run,meanLatencyMs,p95LatencyMs,deviation,missed,pareto,parameters" << endl;
+		for (size_t i = 0; i < runs.size(); i++)
+		{
+			csv << i << "," << runs[i].meanLatency << "," << runs[i].p95Latency << ","
+				<< runs[i].deviation << "," << runs[i].missed << "," << runs[i].pareto << ",\""
+				<< runs[i].label << "\"" << endl;
+		}
+	}
+
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,241 @@
+//=====================================================
+// morton_benchmark
+// - Times the neighbor search consumers of the
+// locator on the down sampled clouds of a recorded
+// sequence, or of a synthetic drive without one,
+// once in voxel grid order and once sorted along
+// the Z-order curve
+//=====================================================
+#include <iostream>
+#include <algorithm>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <pcl/point_types.h>
+#include <pcl/common/io.h>
+#include <pcl/filters/passthrough.h>
+#include <pcl/filters/voxel_grid.h>
+#include <pcl/filters/statistical_outlier_removal.h>
+#include <pcl/features/normal_3d_omp.h>
+#include <pcl/search/kdtree.h>
+#include <pcl/segmentation/extract_clusters.h>
+#include "depth_sequence.h"
+#include "field_synth.h"
+#include "locator_params.h"
+#include "morton_order.h"
+
+using namespace std;
+
+typedef pcl::PointXYZ                  BenchPoint;
+typedef pcl::PointCloud<BenchPoint>    BenchCloud;
+
+//-- Synthetic frames rendered without a sequence
+#define SYNTHETIC_FRAMES 30
+
+//-- Consumers timed on every cloud, the ordering itself is timed with the Morton layout
+enum BenchStep
+{
+	STEP_ORDER = 0,
+	STEP_KDTREE,
+	STEP_NORMALS,
+	STEP_SOR,
+	STEP_CLUSTERS,
+	STEP_NUM
+};
+
+static const char* stepNames[STEP_NUM] = { "morton sort", "kdtree build", "normal radius", "outlier kNN", "clustering" };
+
+typedef struct
+{
+	double total[STEP_NUM];   /* milliseconds over all frames and repeats */
+
+} BenchTimes;
+
+static double elapsedMs(chrono::steady_clock::time_point start)
+{
+	return chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+}
+
+static void printUsage(void)
+{
+	cout << "Usage: morton_benchmark [options] [sequence]\n"
+		<< "  --frames <n>           frames of the sequence to use (default: all), or synthetic frames without one (default: 30)\n"
+		<< "  --repeat <n>           runs per frame and layout (default: 3)\n"
+		<< "  --set <name=value>     locator parameter, scaled to the stream like the locator does" << endl;
+}
+
+//-- Pass through and voxel grid like filterCloud, in voxel grid order
+static void downSample(const DepthFrame& source, const LocatorParams& params, BenchCloud::Ptr cloud)
+{
+	DepthFrame frame = source;
+	decimateDepthFrame(frame, resolveDecimation(params.depthDecimation, frame.intrinsics.width));
+	deprojectDepthFrame(frame, *cloud);
+
+	pcl::PassThrough<BenchPoint> pass;
+	pass.setInputCloud(cloud);
+	pass.setFilterFieldName("x");
+	pass.setFilterLimits(-1.0f, 1.0f);
+	pass.filter(*cloud);
+
+	pass.setInputCloud(cloud);
+	pass.setFilterFieldName("z");
+	pass.setFilterLimits(0.0f, 4.0f);
+	pass.filter(*cloud);
+
+	pcl::VoxelGrid<BenchPoint> grid;
+	grid.setInputCloud(cloud);
+	grid.setLeafSize(params.voxelLeaf, params.voxelLeaf, params.voxelLeaf);
+	grid.filter(*cloud);
+}
+
+static void runConsumers(BenchCloud::Ptr cloud, const LocatorParams& params, BenchTimes& times)
+{
+	chrono::steady_clock::time_point start = chrono::steady_clock::now();
+	pcl::search::KdTree<BenchPoint>::Ptr tree(new pcl::search::KdTree<BenchPoint>);
+	tree->setInputCloud(cloud);
+	times.total[STEP_KDTREE] += elapsedMs(start);
+
+	start = chrono::steady_clock::now();
+	pcl::NormalEstimationOMP<BenchPoint, pcl::Normal> estimation;
+	pcl::PointCloud<pcl::Normal> normals;
+	estimation.setNumberOfThreads(params.normalThreads);
+	estimation.setInputCloud(cloud);
+	estimation.setSearchMethod(tree);
+	estimation.setRadiusSearch(params.horizontalNormalRadius);
+	estimation.compute(normals);
+	times.total[STEP_NORMALS] += elapsedMs(start);
+
+	start = chrono::steady_clock::now();
+	BenchCloud inliers;
+	pcl::StatisticalOutlierRemoval<BenchPoint> sor;
+	sor.setInputCloud(cloud);
+	sor.setMeanK(params.sorMeanK);
+	sor.setStddevMulThresh(params.sorStddevMul);
+	sor.filter(inliers);
+	times.total[STEP_SOR] += elapsedMs(start);
+
+	start = chrono::steady_clock::now();
+	vector<pcl::PointIndices> clusters;
+	pcl::EuclideanClusterExtraction<BenchPoint> extraction;
+	extraction.setClusterTolerance(params.clusterTolerance);
+	extraction.setMinClusterSize(1);
+	extraction.setSearchMethod(tree);
+	extraction.setInputCloud(cloud);
+	extraction.extract(clusters);
+	times.total[STEP_CLUSTERS] += elapsedMs(start);
+}
+
+int main(int argc, char** argv)
+{
+	string sequencePath;
+	size_t frameLimit = 0;
+	int repeat = 3;
+	LocatorParams params;
+
+	for (int i = 1; i < argc; i++)
+	{
+		string arg = argv[i];
+
+		if (arg == "--frames" && i + 1 < argc) { frameLimit = size_t(atoi(argv[++i])); }
+		else if (arg == "--repeat" && i + 1 < argc) { repeat = max(1, atoi(argv[++i])); }
+		else if (arg == "--set" && i + 1 < argc)
+		{
+			string text = argv[++i];
+			size_t eq = text.find('=');
+
+			if (eq == string::npos || !setLocatorParam(params, text.substr(0, eq), atof(text.substr(eq + 1).c_str())))
+			{
+				cerr << "Bad parameter " << text << endl;
+				return EXIT_FAILURE;
+			}
+		}
+		else if (arg.compare(0, 2, "--") == 0) { printUsage(); return EXIT_FAILURE; }
+		else { sequencePath = arg; }
+	}
+
+	//-- A recording, or a synthetic drive over the field without one
+	vector<DepthFrame> frames;
+
+	if (!sequencePath.empty())
+	{
+		if (!loadSequence(sequencePath, frames) || frames.empty())
+		{
+			cerr << "Cannot open sequence " << sequencePath << endl;
+			return EXIT_FAILURE;
+		}
+		if (frameLimit > 0 && frames.size() > frameLimit) { frames.resize(frameLimit); }
+	}
+	else
+	{
+		DepthIntrinsics intrinsics;
+		d435Intrinsics(640, 480, intrinsics);
+
+		FieldLayout layout;
+		DepthNoiseModel noise;
+		FieldSynthesizer synthesizer(layout, noise);
+		CameraPose pose = { 0.0, 0.0, 0.40, 15.0, 0.0 };
+		FieldSceneSource scene(synthesizer, intrinsics, pose, 0.5, 30.0, (frameLimit > 0) ? frameLimit : SYNTHETIC_FRAMES);
+
+		DepthFrame frame;
+		while (scene.grab(frame)) { frames.push_back(frame); }
+	}
+
+	if (params.scaleToResolution) { scaleLocatorParams(params, frames[0].intrinsics.fx); }
+
+	BenchTimes gridTimes = {}, mortonTimes = {};
+	size_t pointSum = 0, spanSum = 0;
+
+	for (size_t f = 0; f < frames.size(); f++)
+	{
+		BenchCloud::Ptr gridCloud(new BenchCloud);
+		downSample(frames[f], params, gridCloud);
+		pointSum += gridCloud->points.size();
+
+		for (int r = 0; r < repeat; r++)
+		{
+			//-- Same points, only the layout differs
+			chrono::steady_clock::time_point start = chrono::steady_clock::now();
+			vector<int> order;
+			mortonOrder(reinterpret_cast<const float*>(gridCloud->points.data()), sizeof(BenchPoint) / sizeof(float),
+				gridCloud->points.size(), float(params.voxelLeaf), order);
+
+			BenchCloud::Ptr mortonCloud(new BenchCloud);
+			pcl::copyPointCloud(*gridCloud, order, *mortonCloud);
+			mortonTimes.total[STEP_ORDER] += elapsedMs(start);
+
+			if (r == 0)
+			{
+				MortonSpans spans;
+				mortonSpans(reinterpret_cast<const float*>(mortonCloud->points.data()), sizeof(BenchPoint) / sizeof(float),
+					mortonCloud->points.size(), float(params.voxelLeaf), spans);
+				spanSum += spans.size();
+			}
+
+			runConsumers(gridCloud, params, gridTimes);
+			runConsumers(mortonCloud, params, mortonTimes);
+		}
+	}
+
+	double runs = double(frames.size()) * repeat;
+
+	printf("%zu %s frames, %.0f points and %.0f blocks per frame, %d runs per frame\n",
+		frames.size(), sequencePath.empty() ? "synthetic" : "recorded", double(pointSum) / frames.size(), double(spanSum) / frames.size(), repeat);
+	printf("%-16s %12s %12s %9s\n", "step", "grid ms", "morton ms", "speedup");
+
+	double gridSum = 0.0, mortonSum = 0.0;
+	for (int s = 0; s < STEP_NUM; s++)
+	{
+		double grid = gridTimes.total[s] / runs;
+		double morton = mortonTimes.total[s] / runs;
+		gridSum += grid;
+		mortonSum += morton;
+
+		if (s == STEP_ORDER) { printf("%-16s %12s %12.3f %9s\n", stepNames[s], "-", morton, "-"); }
+		else { printf("%-16s %12.3f %12.3f %8.2fx\n", stepNames[s], grid, morton, grid / morton); }
+	}
+	printf("%-16s %12.3f %12.3f %8.2fx\n", "total", gridSum, mortonSum, gridSum / mortonSum);
+
+	return EXIT_SUCCESS;
+}